@@ -1,8 +1,8 @@
 import pandas as pd
 import matplotlib.pyplot as plt
 
-strategies = ["first", "best", "worst", "buddy"]
-colors = {"first": "blue", "best": "green", "worst": "orange", "buddy": "red"}
+strategies = ["first", "best", "worst", "buddy", "hybrid", "bitmap", "stack"]
+colors = {"first": "blue", "best": "green", "worst": "orange", "buddy": "red", "hybrid": "purple", "bitmap": "brown", "stack": "gray"}
 
 plt.figure(figsize=(10, 6))
 
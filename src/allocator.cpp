@@ -1,4 +1,12 @@
 #include "allocator.hpp"
+#include "heap_internal.hpp"
+#include "cache_sim.hpp"
+#include "perf_counters.hpp"
+#include "tagged_heap.hpp"
+#include <algorithm>
+#include <climits>
+#include <deque>
+#include <set>
 #include <iostream>
 #include <chrono>
 #include <fstream>
@@ -7,12 +15,51 @@ using namespace std;
 
 vector<Block> memory;
 const size_t MEMORY_SIZE = 1024;
+size_t heap_size = MEMORY_SIZE;
 int next_id = 1;
+size_t last_alloc_offset = 0;
+
+static size_t growth_chunk = 0;        // 0 = fixed-size heap
+static size_t growth_limit = 0;        // maximum footprint, 0 = unlimited
+static size_t trim_threshold = 0;      // auto-trim a free tail this large, 0 = off
+static size_t grow_count = 0;
+static size_t trim_count = 0;
+static size_t peak_heap_size = MEMORY_SIZE;
+static vector<ReclaimHook> reclaim_hooks;
 
 Block::Block(size_t s, size_t sz, bool u, int i) : start(s), size(sz), used(u), id(i) {}
 
 AllocationStrategy current_strategy = FirstFit;
 
+// Free blocks of `memory` keyed by (size, start), so Best-Fit is a lower_bound
+// and Worst-Fit a lookup of the largest size, both O(log n). Kept in step by
+// the split/merge paths; bulk edits just invalidate it and the next lookup
+// rebuilds it, so strategies that never search by size pay nothing.
+static set<pair<size_t, size_t>> free_index;
+static bool free_index_valid = false;
+
+void invalidate_free_index() {
+    free_index_valid = false;
+    free_index.clear();
+    invalidate_bitmap();
+    if (tracing) trace_recount();
+}
+
+static void index_add(const Block& b) {
+    if (free_index_valid) free_index.insert({b.size, b.start});
+}
+
+static void index_remove(const Block& b) {
+    if (free_index_valid) free_index.erase({b.size, b.start});
+}
+
+static void rebuild_free_index() {
+    free_index.clear();
+    for (const auto& block : memory)
+        if (!block.used) free_index.insert({block.size, block.start});
+    free_index_valid = true;
+}
+
 size_t next_power_of_two(size_t n) {
     if (n == 0) return 1;
     size_t power = 1;
@@ -20,199 +67,567 @@ size_t next_power_of_two(size_t n) {
     return power;
 }
 
-void set_strategy(AllocationStrategy strategy) {
+bool set_strategy(AllocationStrategy strategy) {
+    // Buddy's halving assumes a power-of-two heap, which carving the huge
+    // region off the top no longer leaves
+    if (strategy == Buddy && huge_enabled()) return false;
+    // only the Bitmap strategy keeps its map in step with `memory`
+    if (strategy == Bitmap && current_strategy != Bitmap) invalidate_bitmap();
     current_strategy = strategy;
+    return true;
+}
+
+// Ids of freed allocations, reissued oldest first so a stale id stays unused
+// for as long as possible. next_id only advances when none is waiting, so it
+// tracks the peak number of live allocations, not the total ever made.
+static deque<int> free_ids;
+
+int take_id() {
+    if (free_ids.empty()) return next_id++;
+    int id = free_ids.front();
+    free_ids.pop_front();
+    return id;
+}
+
+void recycle_id(int id) {
+    if (id > 0) free_ids.push_back(id);   // not slab blocks
+}
+
+bool ids_exhausted() {
+    return next_id == INT_MAX && free_ids.empty();
 }
 
 void initialize_memory() {
+    reset_heap(MEMORY_SIZE);
+}
+
+void reset_heap(size_t bytes) {
     memory.clear();
+    invalidate_free_index();
+    reset_hybrid();
     next_id = 1;
-    memory.push_back(Block(0, MEMORY_SIZE, false, 0));
+    free_ids.clear();
+    heap_size = bytes;
+    load_startup_size_classes();   // checked against the new heap size
+    peak_heap_size = bytes;
+    grow_count = 0;
+    trim_count = 0;
+    memory.push_back(Block(0, bytes, false, 0));
+    reset_huge();
+    reset_residency();
+    reset_handles();
+    reset_arenas();
+    reset_caches();
+    reset_locality();
 }
 
-int allocate(size_t size) {
-    int target_index = -1;
-
-    if (current_strategy == FirstFit) {
-        for (size_t i = 0; i < memory.size(); ++i) {
-            if (!memory[i].used && memory[i].size >= size) {
-                target_index = i;
-                break;
-            }
-        }
-    } else if (current_strategy == BestFit) {
-        size_t best_size = SIZE_MAX;
-        for (size_t i = 0; i < memory.size(); ++i) {
-            if (!memory[i].used && memory[i].size >= size && memory[i].size < best_size) {
-                best_size = memory[i].size;
-                target_index = i;
-            }
-        }
-    } else if (current_strategy == WorstFit) {
-        size_t worst_size = 0;
-        for (size_t i = 0; i < memory.size(); ++i) {
-            if (!memory[i].used && memory[i].size >= size && memory[i].size > worst_size) {
-                worst_size = memory[i].size;
-                target_index = i;
-            }
-        }
-    }else if (current_strategy == Buddy) {
-        size_t req_size = next_power_of_two(size);
+void set_heap_growth(size_t chunk, size_t max_heap, size_t trim_at) {
+    growth_chunk = (chunk + SIM_PAGE_SIZE - 1) / SIM_PAGE_SIZE * SIM_PAGE_SIZE;
+    growth_limit = max_heap;
+    trim_threshold = trim_at;
+}
 
-        // find the first free block big enough
-        for (size_t i = 0; i < memory.size(); ++i) {
-            if (!memory[i].used && memory[i].size >= req_size) {
-                target_index = i;
-                break;
-            }
-        }
+// Extends the heap sbrk-style so a request of `size` bytes can succeed.
+static bool grow_heap(size_t size) {
+    // new space would land above the huge region, away from the general
+    // heap's top; and Buddy needs power-of-two blocks at aligned addresses,
+    // which page-rounded chunks cannot give it
+    if (growth_chunk == 0 || huge_enabled() || current_strategy == Buddy) return false;
+    uint64_t t0 = tracing ? trace_now() : 0;
+
+    // a free block ending at the break only needs topping up
+    size_t tail_free = 0;
+    if (!memory.empty() && !memory.back().used &&
+        memory.back().start + memory.back().size == heap_size)
+        tail_free = memory.back().size;
+
+    size_t need = size > tail_free ? size - tail_free : 0;
+    size_t bytes = max(growth_chunk, (need + SIM_PAGE_SIZE - 1) / SIM_PAGE_SIZE * SIM_PAGE_SIZE);
+    if (growth_limit > 0 && heap_size + bytes > growth_limit) return false;
+
+    if (tail_free > 0)
+        memory.back().size += bytes;
+    else
+        memory.push_back(Block(heap_size, bytes, false, 0));
+    invalidate_free_index();
+    heap_size += bytes;
+    resize_residency(heap_size);
+    peak_heap_size = max(peak_heap_size, heap_size);
+    grow_count++;
+    if (tracing) {
+        trace_record(TraceGrow, t0, bytes, heap_size, 0);
+        trace_heap();
+    }
+    return true;
+}
 
-        if (target_index != -1) {
-            size_t start = memory[target_index].start;
-            size_t block_size = memory[target_index].size;
-
-            // recursively split until block_size == req_size
-            while (block_size > req_size) {
-                block_size /= 2;
-                // replace current block with first half
-                memory[target_index].size = block_size;
-                // insert second half after it
-                memory.insert(memory.begin() + target_index + 1,
-                              Block(start + block_size, block_size, false, 0));
-            }
+size_t trim_heap() {
+    // only grown space goes back; the initial MEMORY_SIZE stays mapped
+    if (memory.empty() || heap_size <= MEMORY_SIZE) return 0;
+    uint64_t t0 = tracing ? trace_now() : 0;
+    Block& tail = memory.back();
+    if (tail.used || tail.start + tail.size != heap_size) return 0;
+
+    size_t keep_from = max(tail.start, MEMORY_SIZE);
+    keep_from = (keep_from + SIM_PAGE_SIZE - 1) / SIM_PAGE_SIZE * SIM_PAGE_SIZE;
+    if (keep_from >= heap_size) return 0;
+
+    size_t released = heap_size - keep_from;
+    tail.size -= released;
+    if (tail.size == 0) memory.pop_back();
+    invalidate_free_index();
+    heap_size = keep_from;
+    resize_residency(heap_size);
+    trim_count++;
+    if (tracing) {
+        trace_record(TraceTrim, t0, released, heap_size, 0);
+        trace_heap();
+    }
+    return released;
+}
 
-            int id = next_id++;
-            memory[target_index].used = true;
-            memory[target_index].id = id;
-            return id;
+int find_fit(size_t size, AllocationStrategy fit) {
+    if (fit == BestFit || fit == WorstFit) {
+        if (!free_index_valid) rebuild_free_index();
+        if (free_index.empty()) return -1;
+
+        // smallest block that fits, or the largest block overall; ties go to
+        // the lowest address either way, as with a left-to-right scan
+        size_t key = size;
+        if (fit == WorstFit) {
+            key = free_index.rbegin()->first;
+            if (key < size) return -1;
         }
+        auto it = free_index.lower_bound({key, 0});
+        if (it == free_index.end()) return -1;
+        return find_block_at(it->second);
+    }
 
-        return -1; // no block found
+    for (size_t i = 0; i < memory.size(); ++i) {
+        if (!memory[i].used && memory[i].size >= size)
+            return i;
     }
+    return -1;
+}
 
-    // existing unified logic for FirstFit/BestFit/WorstFit...
-    if (target_index != -1) {
-        size_t start = memory[target_index].start;
-        size_t old_size = memory[target_index].size;
+void place_block(size_t index, size_t size, int id) {
+    size_t start = memory[index].start;
+    size_t old_size = memory[index].size;
+
+    index_remove(memory[index]);
+    memory[index].used = true;
+    memory[index].size = size;
+    memory[index].id = id;
+    pages_touch(start, size);
+    last_alloc_offset = start;
+    if (tracing) trace_used(size);
+
+    size_t leftover = old_size - size;
+    if (leftover > 0) {
+        if (tracing) trace_record(TraceSplit, 0, start, size, leftover);
+        memory.insert(memory.begin() + index + 1,
+                      Block(start + size, leftover, false, 0));
+        index_add(memory[index + 1]);
+    }
+}
 
-        int id = next_id++;
+void split_free_block(size_t index, size_t first_size) {
+    Block& block = memory[index];
+    Block rest(block.start + first_size, block.size - first_size, false, 0);
+    if (tracing) trace_record(TraceSplit, 0, block.start, first_size, rest.size);
+    index_remove(block);
+    block.size = first_size;
+    index_add(block);
+    memory.insert(memory.begin() + index + 1, rest);
+    index_add(rest);
+}
 
-        memory[target_index].used = true;
-        memory[target_index].size = size;
-        memory[target_index].id = id;
+int allocate_fit(size_t size, AllocationStrategy fit) {
+    int target_index = find_fit(size, fit);
+    if (target_index == -1) return -1;  // Allocation failed
 
-        size_t leftover = old_size - size;
-        if (leftover > 0) {
-            memory.insert(memory.begin() + target_index + 1,
-                          Block(start + size, leftover, false, 0));
-        }
+    int id = take_id();
+    place_block(target_index, size, id);
+    return id;
+}
 
+static int allocate_buddy(size_t size) {
+    size_t req_size = next_power_of_two(size);
+
+    // find the first free block big enough
+    int target_index = find_fit(req_size, FirstFit);
+    if (target_index == -1) return -1; // no block found
+
+    size_t start = memory[target_index].start;
+    size_t block_size = memory[target_index].size;
+    index_remove(memory[target_index]);
+
+    // recursively split until block_size == req_size
+    while (block_size > req_size) {
+        block_size /= 2;
+        if (tracing) trace_record(TraceSplit, 0, start, block_size, block_size);
+        // replace current block with first half
+        memory[target_index].size = block_size;
+        // insert second half after it
+        memory.insert(memory.begin() + target_index + 1,
+                      Block(start + block_size, block_size, false, 0));
+        index_add(memory[target_index + 1]);
+    }
+
+    int id = take_id();
+    memory[target_index].used = true;
+    memory[target_index].id = id;
+    if (tracing) trace_used(req_size);
+    pages_touch(start, req_size);
+    last_alloc_offset = start;
+    return id;
+}
+
+// Last free block that fits, carved from its high end.
+static int allocate_high(size_t size) {
+    for (size_t i = memory.size(); i-- > 0;) {
+        if (memory[i].used || memory[i].size < size) continue;
+        if (memory[i].size > size) {
+            split_free_block(i, memory[i].size - size);
+            i++;
+        }
+        int id = take_id();
+        place_block(i, size, id);
         return id;
     }
+    return -1;
+}
 
-    return -1;  // Allocation failed
+static int allocate_general(size_t size) {
+    if (current_strategy == Hybrid) return allocate_hybrid(size);
+    if (current_strategy == Buddy) return allocate_buddy(size);
+    if (current_strategy == Bitmap) return allocate_bitmap(size);
+    if (current_strategy == Stack) return allocate_stack(size);
+    return allocate_fit(size, current_strategy);
 }
 
+void add_reclaim_hook(ReclaimHook hook) {
+    reclaim_hooks.push_back(hook);
+}
 
+static size_t run_reclaim_hooks() {
+    size_t reclaimed = 0;
+    for (ReclaimHook hook : reclaim_hooks) reclaimed += hook();
+    return reclaimed;
+}
 
-bool free_block(int id) {
-    for (size_t i = 0; i < memory.size(); ++i) {
-        if (memory[i].id == id && memory[i].used) {
-            memory[i].used = false;
-            memory[i].id = 0;
-
-            if (current_strategy == Buddy) {
-                size_t block_size = memory[i].size;
-                size_t block_start = memory[i].start;
-
-                bool merged = true;
-                while (merged) {
-                    merged = false;
-                    size_t buddy_start = block_start ^ block_size;
-
-                    // search for buddy
-                    for (size_t j = 0; j < memory.size(); ++j) {
-                        if (j == i) continue;
-                        if (!memory[j].used &&
-                            memory[j].size == block_size &&
-                            memory[j].start == buddy_start) {
-                            // merge
-                            size_t new_start = min(block_start, buddy_start);
-                            block_size *= 2;
-
-                            // erase the higher index first to keep `i` valid
-                            if (j > i) {
-                                memory.erase(memory.begin() + j);
-                                memory.erase(memory.begin() + i);
-                            } else {
-                                memory.erase(memory.begin() + i);
-                                memory.erase(memory.begin() + j);
-                                i = j; // adjust index
-                            }
-
-                            // insert merged block
-                            memory.insert(memory.begin() + i,
-                                Block(new_start, block_size, false, 0));
-
-                            block_start = new_start;
-                            merged = true;
-                            break;
-                        }
-                    }
-                }
-            } else {
-                // normal merging
-                if (i + 1 < memory.size() && !memory[i + 1].used) {
-                    memory[i].size += memory[i + 1].size;
-                    memory.erase(memory.begin() + i + 1);
-                }
-                if (i > 0 && !memory[i - 1].used) {
-                    memory[i - 1].size += memory[i].size;
+static int allocate_placed(size_t size, LifetimeHint hint) {
+    bool fit = current_strategy == FirstFit || current_strategy == BestFit ||
+               current_strategy == WorstFit;
+    return hint == LongLived && fit ? allocate_high(size) : allocate_general(size);
+}
+
+int allocate(size_t size) {
+    return allocate(size, LifetimeUnknown);
+}
+
+static int allocate_hinted(size_t size, LifetimeHint hint) {
+    // ids are never reused within a heap; once they run out every allocation
+    // fails (until initialize_memory()) rather than wrapping onto live ids
+    if (ids_exhausted()) return -1;
+    residency_tick();
+    profile_request(size);
+    size = round_to_granule(size);
+    if (is_huge_request(size)) return allocate_huge(size);
+
+    int id = allocate_placed(size, hint);
+    if (id == -1 && run_reclaim_hooks() > 0) id = allocate_placed(size, hint);
+    if (id == -1) {
+        // on failure, grow by enough for the rounded request and retry once
+        size_t need = size;
+        if (current_strategy == Hybrid)
+            need = max(size, get_size_classes().empty() ? 0 : 2 * get_size_classes().back());
+        else if (current_strategy == Bitmap)
+            need = (size + BITMAP_GRANULE - 1) / BITMAP_GRANULE * BITMAP_GRANULE;
+        if (grow_heap(need)) id = allocate_placed(size, hint);
+    }
+    return id;
+}
+
+int allocate(size_t size, LifetimeHint hint) {
+    if (!tracing) return allocate_hinted(size, hint);
+    uint64_t t0 = trace_now();
+    int id = allocate_hinted(size, hint);
+    trace_record(TraceAllocate, t0, id, size, id == -1 ? -1 : (int64_t)last_alloc_offset);
+    trace_heap();
+    return id;
+}
+
+int allocate(size_t size, size_t& offset) {
+    int id = allocate(size);
+    if (id != -1) offset = last_alloc_offset;
+    return id;
+}
+
+int find_block_at(size_t start) {
+    auto it = lower_bound(memory.begin(), memory.end(), start,
+        [](const Block& b, size_t key) { return b.start < key; });
+    if (it == memory.end() || it->start != start) return -1;
+    return it - memory.begin();
+}
+
+static void release_buddy(size_t i) {
+    size_t block_size = memory[i].size;
+    size_t block_start = memory[i].start;
+
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        size_t buddy_start = block_start ^ block_size;
+
+        // search for buddy
+        for (size_t j = 0; j < memory.size(); ++j) {
+            if (j == i) continue;
+            if (!memory[j].used &&
+                memory[j].size == block_size &&
+                memory[j].start == buddy_start) {
+                // merge
+                index_remove(memory[j]);
+                size_t new_start = min(block_start, buddy_start);
+                block_size *= 2;
+
+                // erase the higher index first to keep `i` valid
+                if (j > i) {
+                    memory.erase(memory.begin() + j);
                     memory.erase(memory.begin() + i);
+                } else {
+                    memory.erase(memory.begin() + i);
+                    memory.erase(memory.begin() + j);
+                    i = j; // adjust index
                 }
+
+                // insert merged block
+                memory.insert(memory.begin() + i,
+                    Block(new_start, block_size, false, 0));
+
+                block_start = new_start;
+                merged = true;
+                if (tracing) trace_record(TraceMerge, 0, block_start, block_size, 0);
+                break;
             }
+        }
+    }
+    index_add(memory[i]);
+}
+
+void release_block(size_t i) {
+    if (tracing) trace_used(-(long long)memory[i].size);
+    pages_release(memory[i].start, memory[i].size);
+    memory[i].used = false;
+    recycle_id(memory[i].id);
+    memory[i].id = 0;
+
+    if (current_strategy == Buddy) {
+        release_buddy(i);
+        return;
+    }
+
+    // normal merging (neighbours in the list are not adjacent across the
+    // huge region once the heap has grown past it)
+    if (i + 1 < memory.size() && !memory[i + 1].used &&
+        memory[i].start + memory[i].size == memory[i + 1].start) {
+        index_remove(memory[i + 1]);
+        memory[i].size += memory[i + 1].size;
+        memory.erase(memory.begin() + i + 1);
+        if (tracing) trace_record(TraceMerge, 0, memory[i].start, memory[i].size, 0);
+    }
+    if (i > 0 && !memory[i - 1].used &&
+        memory[i - 1].start + memory[i - 1].size == memory[i].start) {
+        index_remove(memory[i - 1]);
+        memory[i - 1].size += memory[i].size;
+        memory.erase(memory.begin() + i);
+        i--;
+        if (tracing) trace_record(TraceMerge, 0, memory[i].start, memory[i].size, 0);
+    }
+    index_add(memory[i]);
+    if (current_strategy == Bitmap) bitmap_mark_free(memory[i].start, memory[i].size);
+}
+
+static void auto_trim() {
+    if (trim_threshold > 0 && !memory.empty() && !memory.back().used &&
+        memory.back().size >= trim_threshold)
+        trim_heap();
+}
 
+// `size` (0 = unknown) must not exceed the block, as in free_at().
+static bool free_general(int id, size_t size) {
+    if (current_strategy == Stack) {
+        // only the top of the stack may go; no search needed either way
+        int top = stack_top_index();
+        if (top == -1 || memory[top].id != id || size > memory[top].size) return false;
+        release_block(top);
+        auto_trim();
+        return true;
+    }
+    for (size_t i = 0; i < memory.size(); ++i) {
+        if (memory[i].id == id && memory[i].used) {
+            if (size > memory[i].size) return false;
+            release_block(i);
+            auto_trim();
             return true;
         }
     }
     return false;
 }
 
+static bool free_any(int id) {
+    if (free_small(id, 0)) return true;
+    if (free_huge(id, 0)) return true;
+    return free_general(id, 0);
+}
+
+// Records a completed free with its duration and the new occupancy.
+static bool traced_free(TraceKind kind, uint64_t t0, int64_t what, bool ok) {
+    trace_record(kind, t0, what, ok, 0);
+    trace_heap();
+    return ok;
+}
+
+bool free_block(int id) {
+    if (id <= 0) return false;
+    residency_tick();
+    if (!tracing) return free_any(id);
+    uint64_t t0 = trace_now();
+    return traced_free(TraceFree, t0, id, free_any(id));
+}
+
+static bool free_sized(int id, size_t size) {
+    // the size says which path served the request; only fall through to the
+    // block scan if the region or classes were reconfigured since
+    size = round_to_granule(size);
+    if (is_huge_request(size)) return free_huge(id, size) || free_general(id, size);
+    const vector<size_t>& sizes = get_size_classes();
+    if (size > 0 && !sizes.empty() && size <= sizes.back())
+        return free_small(id, size) || free_general(id, size);
+    return free_general(id, size);
+}
+
+bool free_block(int id, size_t size) {
+    if (id <= 0) return false;
+    residency_tick();
+    if (!tracing) return free_sized(id, size);
+    uint64_t t0 = trace_now();
+    return traced_free(TraceFree, t0, id, free_sized(id, size));
+}
+
+// Used block covering `offset`, or memory.end().
+static vector<Block>::iterator used_block_covering(size_t offset) {
+    auto it = upper_bound(memory.begin(), memory.end(), offset,
+                          [](size_t addr, const Block& b) { return addr < b.start; });
+    if (it == memory.begin()) return memory.end();
+    --it;
+    if (!it->used || offset >= it->start + it->size) return memory.end();
+    return it;
+}
+
+int id_at(size_t offset) {
+    if (in_huge_region(offset)) return huge_id_at(offset);
+    auto it = used_block_covering(offset);
+    if (it == memory.end()) return 0;
+    if (it->id == SLAB_BLOCK_ID) return small_id_at(it->start, offset);
+    return it->start == offset ? it->id : 0;
+}
+
+static bool free_offset(size_t offset, size_t size) {
+    if (in_huge_region(offset)) return free_huge_at(offset, size);
+
+    auto it = used_block_covering(offset);
+    if (it == memory.end()) return false;
+    if (it->id == SLAB_BLOCK_ID) return free_small_at(it->start, offset, size);
+    if (it->start != offset || size > it->size) return false;
+    if (current_strategy == Stack && it - memory.begin() != stack_top_index()) return false;
 
+    release_block(it - memory.begin());
+    auto_trim();
+    return true;
+}
+
+bool free_at(size_t offset, size_t size) {
+    residency_tick();
+    if (!tracing) return free_offset(offset, size);
+    uint64_t t0 = trace_now();
+    return traced_free(TraceFreeAt, t0, offset, free_offset(offset, size));
+}
+
+bool free_at(size_t offset) {
+    return free_at(offset, 0);
+}
+
+
+
+static void print_block(const Block& block) {
+    cout << "[" << block.start << " - " << (block.start + block.size - 1) << "] ";
+    if (block.id == SLAB_BLOCK_ID)
+        cout << "Slab";
+    else
+        cout << (block.used ? "Used" : "Free")
+             << (block.used ? (" (ID: " + to_string(block.id) + ")") : "");
+    cout << " Size: " << block.size << "\n";
+}
 
 void show_memory() {
     cout << "\nMemory Layout:\n";
-    for (const auto& block : memory) {
-        cout << "[" << block.start << " - " << (block.start + block.size - 1)
-                  << "] " << (block.used ? "Used" : "Free")
-                  << (block.used ? (" (ID: " + to_string(block.id) + ")") : "")
-                  << " Size: " << block.size << "\n";
-    }
+    for (const auto& block : memory) print_block(block);
+    show_huge_spans();
 }
 
-void show_fragmentation_stats() {
-    size_t total_free = 0;
-    size_t largest_free_block = 0;
-    int fragment_count = 0;
+void show_memory(size_t from, size_t to) {
+    cout << "\nMemory Layout [" << from << " - " << to << "]:\n";
+    // first block whose range reaches `from`, then walk until past `to`
+    auto it = upper_bound(memory.begin(), memory.end(), from,
+                          [](size_t addr, const Block& b) { return addr < b.start; });
+    if (it != memory.begin()) --it;
+    for (; it != memory.end() && it->start <= to; ++it)
+        if (it->start + it->size > from) print_block(*it);
+}
+
+HeapStats get_heap_stats() {
+    HeapStats stats{};
 
     for (const auto& block : memory) {
         if (!block.used) {
-            total_free += block.size;
-            largest_free_block = max(largest_free_block, block.size);
-            fragment_count++;
+            stats.total_free += block.size;
+            stats.largest_free = max(stats.largest_free, block.size);
+            stats.fragments++;
+        } else {
+            stats.used_blocks++;
         }
     }
 
-    double fragmentation = 0.0;
-    if (total_free > 0 && largest_free_block > 0 && fragment_count > 1) {
-        fragmentation = 1.0 - (double)largest_free_block / total_free;
+    if (stats.total_free > 0 && stats.largest_free > 0 && stats.fragments > 1) {
+        stats.fragmentation = 1.0 - (double)stats.largest_free / stats.total_free;
     }
+    stats.footprint = heap_size;
+    stats.peak_footprint = peak_heap_size;
+    stats.grow_count = grow_count;
+    stats.trim_count = trim_count;
+    return stats;
+}
+
+void show_fragmentation_stats() {
+    HeapStats stats = get_heap_stats();
 
     cout << "\n[Fragmentation Stats]\n";
-    cout << "Total Free Memory     : " << total_free << " bytes\n";
-    cout << "Largest Free Block    : " << largest_free_block << " bytes\n";
-    cout << "Number of Fragments   : " << fragment_count << "\n";
-    cout << "External Fragmentation: " << fragmentation * 100 << "%\n";
+    cout << "Total Free Memory     : " << stats.total_free << " bytes\n";
+    cout << "Largest Free Block    : " << stats.largest_free << " bytes\n";
+    cout << "Number of Fragments   : " << stats.fragments << "\n";
+    cout << "External Fragmentation: " << stats.fragmentation * 100 << "%\n";
+    cout << "Heap Footprint        : " << stats.footprint << " bytes (peak "
+         << stats.peak_footprint << ", grown " << stats.grow_count
+         << "x, trimmed " << stats.trim_count << "x)\n";
+    show_residency_stats();
+    show_metadata_stats();
+
+    if (current_strategy == Hybrid) show_hybrid_stats();
+    if (huge_enabled()) show_huge_stats();
+    show_arena_stats();
+    show_cache_stats();
+    show_locality_stats();
 }
 
 void show_memory_ascii(int width) {
@@ -220,78 +635,255 @@ void show_memory_ascii(int width) {
     vector<char> canvas(width, '_');
 
     for (const auto& block : memory) {
-        int start = (block.start * width) / MEMORY_SIZE;
-        int end = ((block.start + block.size) * width) / MEMORY_SIZE;
+        int start = (block.start * width) / heap_size;
+        int end = ((block.start + block.size) * width) / heap_size;
         for (int i = start; i < end && i < width; i++) {
             canvas[i] = block.used ? '#' : '.';
         }
     }
 
+    fill_huge_ascii(canvas);
+
     for (char c : canvas) cout << c;
     cout << "\n";
 }
 
 void run_benchmarks(int ops, int max_alloc) {
-    std::vector<std::pair<AllocationStrategy, std::string>> strategies = {
-        {FirstFit, "first"},
-        {BestFit,  "best"},
-        {WorstFit, "worst"},
-        {Buddy,    "buddy"}
-    };
+    WorkloadConfig config;
+    config.ops = ops;
+    config.max_alloc = max_alloc;
+    run_benchmarks(config);
+}
+
+// The cache simulator's synthetic reads: `touches` live allocations, either
+// the newest ones or random ones. ids[seq] == -1 marks failed or freed.
+static void touch_live_blocks(CacheSim& sim, const CacheSimConfig& config,
+                              const std::vector<int>& ids,
+                              const std::vector<std::pair<size_t, size_t>>& spans,
+                              Xoshiro256& rng) {
+    if (ids.empty()) return;
+    if (config.pattern == RecentWalk) {
+        int touched = 0;
+        // bounded look-back, so a long run of dead entries costs little
+        for (size_t seq = ids.size(), seen = 0;
+             seq-- > 0 && touched < config.touches && seen < 8 * (size_t)config.touches; ++seen) {
+            if (ids[seq] == -1) continue;
+            sim.access(spans[seq].first, spans[seq].second);
+            touched++;
+        }
+        return;
+    }
+    for (int t = 0; t < config.touches; ++t) {
+        size_t seq = rng.below(ids.size());
+        if (ids[seq] != -1) sim.access(spans[seq].first, spans[seq].second);
+    }
+}
+
+// Replays the same workload on a TaggedHeap of MEMORY_SIZE bytes, so the
+// in-band boundary-tag design shows up next to the strategies. It has its own
+// buffer and offsets, so there is no cache simulation or RSS column.
+static void run_tagged_benchmark(const WorkloadConfig& config, PerfCounters& counters,
+                                 std::ofstream& summary) {
+    TaggedHeap heap(MEMORY_SIZE);
+    WorkloadGenerator workload(config);
+    std::vector<size_t> offsets;   // by allocation sequence number, TAG_NULL = failed or freed
+    offsets.reserve(config.ops);
+    int failed = 0;
+
+    std::ofstream log("benchmark_tagged.csv");
+    log << "step,total_free,max_free,fragments,fragmentation_ratio,rss\n";
+
+    using namespace std::chrono;
+    auto start_time = high_resolution_clock::now();
+    counters.start();
+    for (int i = 0; i < config.ops; i++) {
+        WorkloadOp op = workload.next();
+        if (op.alloc) {
+            size_t at = heap.allocate(op.size);
+            if (at == TAG_NULL) failed++;
+            offsets.push_back(at);
+        } else if (offsets[op.target] != TAG_NULL) {
+            heap.free(offsets[op.target]);
+            offsets[op.target] = TAG_NULL;
+        }
+        if (i % 50 != 0) continue;
+        counters.pause();
+        TagStats stats = heap.stats();
+        double frag = stats.total_free ? 1.0 - (double)stats.largest_free / stats.total_free : 0.0;
+        log << i << "," << stats.total_free << "," << stats.largest_free << ","
+            << stats.fragments << "," << frag << ",\n";
+        counters.resume();
+    }
+    PerfSample perf = counters.stop();
+    long long us = duration_cast<microseconds>(high_resolution_clock::now() - start_time).count();
+
+    std::cout << "[Benchmark Finished] Strategy=tagged Ops=" << config.ops
+              << " Failed=" << failed << " Time=" << us / 1000 << " ms";
+    summary << "tagged," << config.ops << "," << failed << "," << us;
+    if (perf.valid) {
+        double ops = config.ops > 0 ? config.ops : 1;
+        double ipc = perf.cycles ? (double)perf.instructions / perf.cycles : 0.0;
+        std::cout << " IPC=" << ipc;
+        summary << "," << perf.cycles << "," << perf.instructions << "," << ipc << ","
+                << perf.cache_misses / ops << "," << perf.branch_misses / ops;
+    } else {
+        summary << ",,,,,";
+    }
+    summary << "\n";
+    std::cout << "\nResults saved to benchmark_tagged.csv\n";
+}
 
-    for (auto& [strat, name] : strategies) {
+void run_benchmarks(const WorkloadConfig& config) {
+    struct BenchmarkRun {
+        AllocationStrategy strategy;
+        std::string name;
+        bool lifetime_hints;   // pass the generator's lifetimes to allocate()
+    };
+    std::vector<BenchmarkRun> strategies = {
+        {FirstFit, "first",  false},
+        {BestFit,  "best",   false},
+        {WorstFit, "worst",  false},
+        {Buddy,    "buddy",  false},
+        {Hybrid,   "hybrid", false},
+        {Bitmap,   "bitmap", false}
+    };
+    // Stack rejects out-of-order frees, so it only runs on LIFO workloads
+    if (config.pattern == StackLifo) strategies.push_back({Stack, "stack", false});
+    // mixed lifetimes: rerun the fit strategies with lifetime placement
+    if (config.pattern == MixedLifetime) {
+        strategies.push_back({FirstFit, "first-lifetime", true});
+        strategies.push_back({BestFit,  "best-lifetime",  true});
+        strategies.push_back({WorstFit, "worst-lifetime", true});
+    }
+    std::vector<std::pair<std::string, long long>> times;   // microseconds
+    std::vector<double> avg_frag;
+
+    std::cout << "[Workload] pattern=" << workload_pattern_name(config.pattern)
+              << " sizes=" << size_distribution_name(config.sizes)
+              << " seed=" << config.seed << "\n";
+
+    // one row per strategy; counter columns stay empty without a PMU
+    PerfCounters counters;
+    if (!counters.available())
+        std::cout << "[Perf] hardware counters unavailable, timing only\n";
+    std::ofstream summary("benchmark_summary.csv");
+    summary << "strategy,ops,failed,time_us,cycles,instructions,ipc,"
+               "cache_misses_per_op,branch_misses_per_op\n";
+
+    for (auto& [strat, name, hints] : strategies) {
         initialize_memory();
-        set_strategy(strat);
+        if (!set_strategy(strat)) {
+            std::cout << "[Benchmark Skipped] Strategy=" << name << " (huge region configured)\n";
+            times.push_back({name, 0});
+            avg_frag.push_back(0.0);
+            continue;
+        }
+        double frag_sum = 0;
+        int samples = 0;
+
+        // every strategy replays the same seeded stream; ids are indexed by
+        // the generator's allocation sequence number (-1 = failed or freed)
+        WorkloadGenerator workload(config);
+        std::vector<int> ids;
+        ids.reserve(config.ops);
+        int failed = 0;
+
+        // optional cache model: (offset, size) per allocation sequence number
+        const CacheSimConfig* sim_config = cache_simulation();
+        CacheSim sim(sim_config ? *sim_config : CacheSimConfig{});
+        std::vector<std::pair<size_t, size_t>> spans;
+        Xoshiro256 touch_rng(config.seed ^ 0x5eed);
 
-        std::vector<int> allocated;
-        allocated.reserve(ops);
+        std::ofstream log("benchmark_" + name + ".csv");
+        log << "step,total_free,max_free,fragments,fragmentation_ratio,rss\n";
 
         using namespace std::chrono;
         auto start_time = high_resolution_clock::now();
-
-        std::ofstream log("benchmark_" + name + ".csv");
-        log << "step,total_free,max_free,fragments,fragmentation_ratio\n";
-
-        for (int i = 0; i < ops; i++) {
-            if ((rand() % 2 == 0) && !allocated.empty()) {
-                int idx = rand() % allocated.size();
-                int id = allocated[idx];
-                if (free_block(id)) {
-                    allocated.erase(allocated.begin() + idx);
-                }
-            } else {
-                int size = 1 + rand() % max_alloc;
-                int id = allocate(size);
-                if (id != -1) allocated.push_back(id);
+        counters.start();
+
+        for (int i = 0; i < config.ops; i++) {
+            WorkloadOp op = workload.next();
+            if (op.alloc) {
+                int id = hints ? allocate(op.size, op.long_lived ? LongLived : ShortLived)
+                               : allocate(op.size);
+                if (id == -1) failed++;
+                ids.push_back(id);
+                spans.push_back({last_alloc_offset, op.size});
+            } else if (ids[op.target] != -1) {
+                free_block(ids[op.target]);
+                ids[op.target] = -1;
             }
 
-            if (i % 50 == 0) {
-                size_t total_free = 0;
-                size_t max_free = 0;
-                int fragments = 0;
-                for (const auto& b : memory) {
-                    if (!b.used) {
-                        total_free += b.size;
-                        max_free = std::max(max_free, b.size);
-                        fragments++;
-                    }
-                }
-                double frag_ratio = 0.0;
-                if (total_free > 0 && max_free > 0 && fragments > 1)
-                    frag_ratio = 1.0 - (double)max_free / total_free;
-
-                log << i << "," << total_free << "," << max_free << ","
-                    << fragments << "," << frag_ratio << "\n";
+            // the cache model and the CSV sampling are measurement, not
+            // allocator work: keep them out of the hardware counts
+            bool sample = i % 50 == 0;
+            if (!sim_config && !sample) continue;
+            counters.pause();
+            if (sim_config) {
+                if (op.alloc && ids.back() != -1) sim.access(last_alloc_offset, op.size);
+                touch_live_blocks(sim, *sim_config, ids, spans, touch_rng);
+            }
+            if (sample) {
+                HeapStats stats = get_heap_stats();
+                log << i << "," << stats.total_free << "," << stats.largest_free << ","
+                    << stats.fragments << "," << stats.fragmentation << ","
+                    << get_residency_stats().rss_bytes << "\n";
+                frag_sum += stats.fragmentation;
+                samples++;
             }
+            counters.resume();
         }
 
+        PerfSample perf = counters.stop();
         auto end_time = high_resolution_clock::now();
         auto duration = duration_cast<std::chrono::milliseconds>(end_time - start_time).count();
+        times.push_back({name, duration_cast<microseconds>(end_time - start_time).count()});
+        avg_frag.push_back(samples ? frag_sum / samples : 0.0);
 
         log.close();
         std::cout << "[Benchmark Finished] Strategy=" << name
-                  << " Ops=" << ops
-                  << " Time=" << duration << " ms\n"
-                  << "Results saved to benchmark_" << name << ".csv\n";
+                  << " Ops=" << config.ops
+                  << " Failed=" << failed
+                  << " Time=" << duration << " ms";
+        summary << name << "," << config.ops << "," << failed << "," << times.back().second;
+        if (perf.valid) {
+            double ops = config.ops > 0 ? config.ops : 1;
+            double ipc = perf.cycles ? (double)perf.instructions / perf.cycles : 0.0;
+            std::cout << " IPC=" << ipc
+                      << " cache_misses/op=" << perf.cache_misses / ops
+                      << " branch_misses/op=" << perf.branch_misses / ops;
+            summary << "," << perf.cycles << "," << perf.instructions << "," << ipc << ","
+                    << perf.cache_misses / ops << "," << perf.branch_misses / ops;
+        } else {
+            summary << ",,,,,";
+        }
+        summary << "\n";
+        std::cout << "\nResults saved to benchmark_" << name << ".csv\n";
+        if (sim_config) {
+            CacheSimStats cs = sim.stats();
+            std::cout << "[Cache Sim] Strategy=" << name
+                      << " L1_hit=" << cs.l1_hit_rate * 100 << "%"
+                      << " L2_hit=" << cs.l2_hit_rate * 100 << "%"
+                      << " memory_reads=" << cs.memory_reads
+                      << " accesses=" << cs.accesses << "\n";
+        }
+    }
+    run_tagged_benchmark(config, counters, summary);
+
+    if (config.pattern == StackLifo) {
+        long long first = times.front().second, stack = times.back().second;
+        std::cout << "[Stack vs FirstFit] stack=" << stack << " us first=" << first << " us";
+        if (stack > 0) std::cout << " speedup=" << (double)first / stack << "x";
+        std::cout << "\n";
+    }
+
+    if (config.pattern == MixedLifetime) {
+        // the three hinted runs mirror the first three plain ones
+        size_t hinted = strategies.size() - 3;
+        for (size_t i = 0; i < 3; ++i)
+            std::cout << "[Lifetime Placement] " << strategies[i].name
+                      << " avg_fragmentation=" << avg_frag[i]
+                      << " with_hints=" << avg_frag[hinted + i]
+                      << " delta=" << avg_frag[hinted + i] - avg_frag[i] << "\n";
     }
 }
@@ -1,6 +1,8 @@
 #pragma once
 #include <vector>
 #include <cstddef>
+#include <cstdint>
+#include "workload.hpp"
 
 struct Block {
     size_t start;
@@ -8,6 +10,7 @@ struct Block {
     bool used;
     int id;
 
+    Block() = default;
     Block(size_t s, size_t sz, bool u, int i);
 };
 
@@ -15,7 +18,165 @@ void initialize_memory();
 int allocate(size_t size);
 bool free_block(int id);
 
+// Lifetime hint for placement: with First/Best/Worst-Fit, long-lived requests
+// are placed from the top of the heap down (last fitting block, carved from
+// its high end) while everything else keeps the strategy's low-first
+// placement, so short-lived churn does not pin long-lived blocks between
+// holes. Other strategies ignore the hint.
+enum LifetimeHint {
+    LifetimeUnknown,
+    ShortLived,
+    LongLived
+};
+
+int allocate(size_t size, LifetimeHint hint);
+
+// Also reports where the allocation starts, for free_at().
+int allocate(size_t size, size_t& offset);
+// Sized deallocation: `size` is the size passed to allocate(). It routes the
+// free straight to the huge, small-object or general path instead of trying
+// each in turn; false if the id is not live on that path or `size` is larger
+// than the allocation.
+bool free_block(int id, size_t size);
+// Frees the allocation starting at `offset`, located by binary search of the
+// address-ordered block list instead of an id scan. The sized form rejects a
+// size larger than the allocation. False if no live allocation starts there.
+bool free_at(size_t offset);
+bool free_at(size_t offset, size_t size);
+
+// Generation-tagged handles, slot-map style: the low 32 bits index a dense,
+// recycled slot table and the high 32 bits carry that slot's generation,
+// bumped on every free. Lookups are O(1) and a stale or double free fails
+// because the generation no longer matches. 0 is never a valid handle.
+using Handle = uint64_t;
+constexpr Handle NULL_HANDLE = 0;
+
+Handle allocate_handle(size_t size);
+bool free_handle(Handle handle);
+bool handle_valid(Handle handle);
+int handle_id(Handle handle);           // 0 if stale
+size_t handle_offset(Handle handle);    // SIZE_MAX if stale
+size_t handle_slots();                  // table size: peak live handles
+
+// Arenas: bump allocation inside one block taken from the current strategy.
+// Objects are never freed one by one; arena_reset() drops them all in O(1)
+// and scopes roll back to the point they were pushed. Arena ids are > 0.
+int arena_create(size_t bytes);
+bool arena_destroy(int arena);          // hands the block back to the heap
+// Heap offset of `size` bytes aligned to `align` (a power of two), or SIZE_MAX.
+size_t arena_alloc(int arena, size_t size, size_t align = 8);
+bool arena_push_scope(int arena);
+bool arena_pop_scope(int arena);
+bool arena_reset(int arena);
+
+struct ArenaStats {
+    size_t arenas;
+    size_t capacity;        // bytes held from the heap
+    size_t used;            // bump pointer distance, padding included
+    size_t peak;            // high-water mark of used
+    size_t padding;         // alignment bytes inside used
+    size_t waste;           // capacity - used: held but unusable by others
+    size_t allocs;
+    size_t failures;
+    size_t resets;
+};
+
+ArenaStats get_arena_stats(int arena);   // 0 = all arenas
+
+// Co-allocation: places `size` bytes in the free block closest in address to
+// the live block `neighbour_id`, walking outward from it along the address-
+// ordered block list, and carves from the side facing it. First/Best/Worst-
+// Fit only; otherwise, or when nothing nearby fits, falls back to allocate().
+int allocate_near(size_t size, int neighbour_id);
+
+struct LocalityStats {
+    size_t hinted;          // allocate_near() calls
+    size_t placed_near;
+    size_t fallbacks;       // served by plain allocate()
+    double avg_gap;         // bytes between a hinted block and its neighbour
+    double avg_plain_gap;   // same, had the strategy placed it unhinted
+};
+
+LocalityStats get_locality_stats();
+
+// Tracing: allocate, free, split, merge and heap grow/trim events plus a
+// heap-occupancy counter are written to `path` as Chrome trace-event JSON
+// (chrome://tracing, ui.perfetto.dev). Events go through a lock-free ring
+// drained by a writer thread, so the allocator never formats or does I/O;
+// if the writer falls a full ring behind, events are dropped and counted.
+bool trace_start(const char* path);
+size_t trace_stop();   // flushes and closes the file; returns events written
+
+struct TraceStats {
+    size_t recorded;
+    size_t written;
+    size_t dropped;        // ring full
+};
+
+TraceStats get_trace_stats();
+
+// Memory-pressure hooks: when an allocation is about to fail, allocate() runs
+// every hook (each returns the bytes it handed back to the heap) and retries
+// once before growing the heap.
+using ReclaimHook = size_t (*)();
+void add_reclaim_hook(ReclaimHook hook);
+
+// Object caches (Bonwick-style), real-backed mode only. Objects of one type
+// are constructed once when first carved from the heap; freeing one keeps it
+// constructed in its cache (up to `depth` objects), so the next cache_alloc()
+// skips both the placement search and the constructor. The destructor runs
+// only when an object really leaves the cache: overflow, cache_reclaim(), or
+// memory pressure. Objects are addressed by heap offset (heap_base() + offset).
+using ObjectCtor = void (*)(void* obj, void* arg);
+using ObjectDtor = void (*)(void* obj, void* arg);
+
+int cache_create(size_t obj_size, ObjectCtor ctor, ObjectDtor dtor, void* arg = nullptr,
+                 size_t depth = 16);          // cache id > 0, or -1 without real backing
+bool cache_set_depth(int cache, size_t depth);
+size_t cache_alloc(int cache);                // heap offset, or SIZE_MAX
+bool cache_free(int cache, size_t offset);
+size_t cache_reclaim(int cache);              // 0 = all caches; returns bytes freed
+
+struct CacheStats {
+    size_t obj_size;
+    size_t depth;
+    size_t cached;          // constructed objects waiting for reuse
+    size_t live;
+    size_t hits;            // allocations served from the cache
+    size_t misses;          // allocations that hit the heap and the constructor
+    size_t constructed;
+    size_t destroyed;
+    size_t reclaimed;       // objects released under pressure or by cache_reclaim
+};
+
+CacheStats get_cache_stats(int cache);
+
+struct HeapStats {
+    size_t total_free;
+    size_t largest_free;
+    int fragments;
+    size_t used_blocks;
+    double fragmentation;   // 1 - largest_free / total_free
+    size_t footprint;       // current heap size
+    size_t peak_footprint;
+    size_t grow_count;
+    size_t trim_count;
+};
+
+HeapStats get_heap_stats();
+
+// Expandable heap: when an allocation fails, extend the heap sbrk-style by at
+// least `chunk` bytes (page-rounded) up to `max_heap` (0 = unlimited) and retry.
+// A free tail of at least `trim_at` bytes is trimmed automatically on free
+// (0 = only on trim_heap()). chunk 0 keeps the heap fixed at MEMORY_SIZE.
+// The heap never grows under Buddy or while a huge region is configured.
+void set_heap_growth(size_t chunk, size_t max_heap = 0, size_t trim_at = 0);
+// Releases a free tail above MEMORY_SIZE; returns the bytes trimmed.
+size_t trim_heap();
+
 void show_memory();
+// Only the blocks overlapping [from, to]; a binary search finds the first one.
+void show_memory(size_t from, size_t to);
 void show_fragmentation_stats();
 void show_memory_ascii(int width = 64);
 
@@ -23,13 +184,170 @@ enum AllocationStrategy {
     FirstFit,
     BestFit,
     WorstFit,
-    Buddy
+    Buddy,
+    Hybrid,     // size-class slabs below the small threshold, first-fit above
+    Bitmap,     // first-fit over a granule occupancy bitmap
+    Stack       // LIFO bump allocation off the top free block
 };
 
+// Granule tracked by one bit in the Bitmap strategy; requests round up to it.
+constexpr size_t BITMAP_GRANULE = 16;
+
+// Stack strategy: allocation splits the free block at the top of the heap and
+// only the most recent live allocation may be freed; any other free fails.
+// A marker is the current top offset; popping to it frees everything above
+// it, newest first. Both return SIZE_MAX / false outside the Stack strategy.
+size_t push_marker();
+bool pop_to_marker(size_t marker);
+
 extern AllocationStrategy current_strategy;
-void set_strategy(AllocationStrategy strategy);
+// Fails for Buddy while a huge region is configured.
+bool set_strategy(AllocationStrategy strategy);
+
+// Hybrid strategy: requests up to the small threshold are rounded to a size
+// class and served from slabs; larger ones use coalescing first-fit. Both
+// setters fail while small objects are live, and for a largest class above
+// max_small_threshold(): half the heap, so a slab can hold two objects.
+bool set_small_threshold(size_t bytes);
+size_t max_small_threshold();
+bool set_size_classes(const std::vector<size_t>& classes);
+const std::vector<size_t>& get_size_classes();
+
+struct HybridStats {
+    // small-object path
+    size_t slabs;
+    size_t slab_bytes;
+    size_t live_objects;
+    size_t requested_bytes;   // sum of caller sizes
+    size_t class_bytes;       // sum of rounded size-class sizes
+    size_t free_slots;
+    size_t small_allocs;
+    // large path
+    size_t large_blocks;
+    size_t large_bytes;
+    size_t large_allocs;
+};
+
+HybridStats get_hybrid_stats();
+
+// Size-class profiling. While enabled, allocate() records every request size
+// (before granule rounding) in a histogram.
+void set_size_profiling(bool enabled);
+void clear_size_profile();
+size_t profiled_requests();
+// Up to `max_classes` classes covering the profiled sizes <= `max_size` that
+// minimize internal fragmentation (bytes lost to rounding up to the class,
+// weighted by frequency); the largest class is the largest such size. Empty
+// when nothing was profiled in range.
+std::vector<size_t> derive_size_classes(size_t max_classes, size_t max_size);
+// Rounding loss of `classes` over the profiled sizes they cover, in bytes.
+size_t size_class_waste(const std::vector<size_t>& classes);
+// Classes that initialize_memory() loads into the Hybrid strategy from now on;
+// empty keeps whatever set_size_classes() last configured.
+void set_startup_size_classes(const std::vector<size_t>& classes);
+
+// Simulated page size used for page-granular spans.
+constexpr size_t SIM_PAGE_SIZE = 64;
+
+// Huge-allocation region: requests of at least `threshold` bytes are served
+// from page-granular spans in a dedicated region carved off the top of the
+// heap, tracked apart from `memory`. Threshold 0 returns the region to the
+// general heap. Fails while huge spans are live, the top of the heap is not
+// free, or the strategy is Buddy.
+bool set_huge_region(size_t threshold, size_t region_bytes);
+
+struct HugeStats {
+    size_t threshold;
+    size_t region_start;
+    size_t region_bytes;
+    size_t used_spans;
+    size_t used_bytes;
+    size_t free_bytes;
+    size_t largest_free;
+    size_t allocs;
+    size_t failures;
+};
+
+HugeStats get_huge_stats();
+
+// Page residency. Every simulated page is in use (overlaps a live allocation)
+// or free in one of three states: clean (never touched, not resident), dirty
+// (freed but still resident) or purged (released back to the OS).
+enum PageState : uint8_t {
+    PageClean,
+    PageDirty,
+    PagePurged,
+    PageInUse
+};
+
+// When fully free pages are purged: never, as soon as they go dirty, or once
+// they have stayed dirty for `decay_ops` allocator operations (a simple
+// stand-in for jemalloc's time-based dirty-page decay).
+enum PurgePolicy {
+    PurgeNone,
+    PurgeImmediate,
+    PurgeDecay
+};
+
+void set_purge_policy(PurgePolicy policy, size_t decay_ops = 100);
+size_t purge_free_pages();   // purges every dirty page now; returns the count
+PageState page_state(size_t page);
+
+// Real-backed mode: mirror the simulated heap with an anonymous mapping so
+// purges become madvise(MADV_DONTNEED) and RSS can be read with mincore().
+bool set_real_backing(bool enabled);
+char* heap_base();   // nullptr unless real-backed
+
+struct ResidencyStats {
+    size_t pages;
+    size_t in_use;
+    size_t dirty;
+    size_t clean;
+    size_t purged;
+    size_t rss_bytes;        // (in_use + dirty) * SIM_PAGE_SIZE
+    size_t purged_total;     // purge events since initialize_memory()
+    size_t real_rss_bytes;   // mincore() on the backing mapping, if any
+};
+
+ResidencyStats get_residency_stats();
+
+// Compact metadata for heaps up to 4 G granules: start and size are stored in
+// granule units and the used flag is packed into bit 0 of size_flags, so a
+// record is 12 bytes against sizeof(Block) == 24. Accounting only: the
+// strategies work on `memory` as Block records, never on this encoding.
+struct CompactBlock {
+    uint32_t start;        // granules
+    uint32_t size_flags;   // size in granules << 1 | used
+    int32_t id;
+
+    bool used() const { return size_flags & 1; }
+    size_t granules() const { return size_flags >> 1; }
+};
+
+// Rounds every request up to a multiple of `bytes` (a power of two up to
+// SIM_PAGE_SIZE; default 1 = byte-exact) so blocks stay granule-aligned.
+bool set_granule(size_t bytes);
+size_t get_granule();
+// Encodes `memory` as compact records. Fails if a block is not granule-aligned
+// or does not fit the 32-bit fields.
+bool pack_blocks(std::vector<CompactBlock>& out);
+void unpack_blocks(const std::vector<CompactBlock>& in);
+
+struct MetadataStats {
+    size_t records;             // entries in `memory`
+    size_t live_allocs;
+    size_t block_bytes;         // records * sizeof(Block)
+    size_t compact_bytes;       // records * sizeof(CompactBlock), 0 if not packable
+    double per_alloc;           // metadata bytes per live allocation
+    double compact_per_alloc;
+};
+
+MetadataStats get_metadata_stats();
 
 extern std::vector<Block> memory;
-extern const size_t MEMORY_SIZE;
+extern const size_t MEMORY_SIZE;   // initial heap size
+extern size_t heap_size;           // current footprint, >= MEMORY_SIZE once grown
+extern int next_id;               // next fresh id; freed ids are reissued first
 
 void run_benchmarks(int ops = 1000, int max_alloc = 200);
+void run_benchmarks(const WorkloadConfig& config);
@@ -0,0 +1,141 @@
+#include "heap_internal.hpp"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+struct Scope {
+    size_t top;
+    size_t padding;
+};
+
+struct Arena {
+    int block_id;        // 0 once destroyed
+    size_t start;
+    size_t capacity;
+    size_t top;          // next free byte, relative to start
+    size_t peak;
+    size_t padding;
+    size_t allocs;
+    size_t failures;
+    size_t resets;
+    vector<Scope> scopes;
+};
+
+static vector<Arena> arenas;   // arena id - 1
+
+void reset_arenas() {
+    // the blocks went with the heap itself
+    arenas.clear();
+}
+
+static Arena* find_arena(int arena) {
+    if (arena <= 0 || (size_t)arena > arenas.size()) return nullptr;
+    Arena& a = arenas[arena - 1];
+    return a.block_id ? &a : nullptr;
+}
+
+int arena_create(size_t bytes) {
+    if (bytes == 0) return -1;
+    size_t offset;
+    int id = allocate(bytes, offset);
+    if (id == -1) return -1;
+    arenas.push_back(Arena{id, offset, bytes, 0, 0, 0, 0, 0, 0, {}});
+    return arenas.size();
+}
+
+bool arena_destroy(int arena) {
+    Arena* a = find_arena(arena);
+    if (!a) return false;
+    // skip the free if the block was already released by id
+    if (id_at(a->start) == a->block_id) free_at(a->start);
+    a->block_id = 0;
+    a->scopes.clear();
+    a->scopes.shrink_to_fit();
+    return true;
+}
+
+size_t arena_alloc(int arena, size_t size, size_t align) {
+    Arena* a = find_arena(arena);
+    if (!a || align == 0 || (align & (align - 1)) != 0) return SIZE_MAX;
+
+    // align the absolute address, not the offset inside the arena; compare
+    // against the space left so neither a huge size nor a huge alignment
+    // can wrap around
+    size_t offset = SIZE_MAX;
+    if (align <= a->capacity) {
+        size_t at = (a->start + a->top + align - 1) & ~(align - 1);
+        offset = at - a->start;
+    }
+    if (offset > a->capacity || size > a->capacity - offset) {
+        a->failures++;
+        return SIZE_MAX;
+    }
+    size_t at = a->start + offset;
+    a->padding += at - (a->start + a->top);
+    a->top = offset + size;
+    a->peak = max(a->peak, a->top);
+    a->allocs++;
+    return at;
+}
+
+bool arena_push_scope(int arena) {
+    Arena* a = find_arena(arena);
+    if (!a) return false;
+    a->scopes.push_back({a->top, a->padding});
+    return true;
+}
+
+bool arena_pop_scope(int arena) {
+    Arena* a = find_arena(arena);
+    if (!a || a->scopes.empty()) return false;
+    a->top = a->scopes.back().top;
+    a->padding = a->scopes.back().padding;
+    a->scopes.pop_back();
+    return true;
+}
+
+bool arena_reset(int arena) {
+    Arena* a = find_arena(arena);
+    if (!a) return false;
+    a->top = 0;
+    a->padding = 0;
+    a->scopes.clear();
+    a->resets++;
+    return true;
+}
+
+static void add_stats(ArenaStats& stats, const Arena& a) {
+    stats.arenas++;
+    stats.capacity += a.capacity;
+    stats.used += a.top;
+    stats.peak += a.peak;
+    stats.padding += a.padding;
+    stats.waste += a.capacity - a.top;
+    stats.allocs += a.allocs;
+    stats.failures += a.failures;
+    stats.resets += a.resets;
+}
+
+ArenaStats get_arena_stats(int arena) {
+    ArenaStats stats{};
+    if (arena != 0) {
+        if (Arena* a = find_arena(arena)) add_stats(stats, *a);
+        return stats;
+    }
+    for (const auto& a : arenas)
+        if (a.block_id) add_stats(stats, a);
+    return stats;
+}
+
+void show_arena_stats() {
+    ArenaStats stats = get_arena_stats(0);
+    if (stats.arenas == 0) return;
+    cout << "\n[Arenas] (" << stats.arenas << " live)\n";
+    cout << "Capacity              : " << stats.capacity << " bytes\n";
+    cout << "Used / Peak           : " << stats.used << " / " << stats.peak << " bytes\n";
+    cout << "Region Waste          : " << stats.waste << " bytes unused, "
+         << stats.padding << " bytes alignment padding\n";
+    cout << "Allocations / Failures: " << stats.allocs << " / " << stats.failures
+         << " (" << stats.resets << " resets)\n";
+}
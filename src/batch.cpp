@@ -0,0 +1,89 @@
+#include "batch.hpp"
+#include <charconv>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+using namespace std;
+
+LineReader::LineReader(int f, size_t chunk_size) : fd(f), buf(chunk_size) {}
+
+bool LineReader::fill() {
+    // slide the partial line to the front, grow if a single line fills the buffer
+    if (begin > 0) {
+        memmove(buf.data(), buf.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+    }
+    if (end == buf.size()) buf.resize(buf.size() * 2);
+
+    ssize_t n;
+    do {
+        n = read(fd, buf.data() + end, buf.size() - end);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        eof = true;
+        return false;
+    }
+    end += n;
+    return true;
+}
+
+bool LineReader::next_line(string_view& line) {
+    size_t scanned = begin;
+    while (true) {
+        const char* base = buf.data();
+        const char* nl = static_cast<const char*>(memchr(base + scanned, '\n', end - scanned));
+        if (nl) {
+            size_t len = nl - (base + begin);
+            line = string_view(base + begin, len);
+            begin += len + 1;
+            break;
+        }
+        if (eof) {
+            if (begin == end) return false;
+            line = string_view(base + begin, end - begin);
+            begin = end;
+            break;
+        }
+        // everything up to `end` has no newline; resume after it once fill()
+        // has moved the unread bytes
+        size_t offset = end - begin;
+        fill();
+        scanned = begin + offset;
+    }
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    return true;
+}
+
+size_t split_tokens(string_view line, string_view* out, size_t max) {
+    size_t count = 0;
+    size_t i = 0;
+    while (count < max) {
+        while (i < line.size() && (line[i] == ' ' || line[i] == '\t')) i++;
+        if (i == line.size()) break;
+        size_t start = i;
+        while (i < line.size() && line[i] != ' ' && line[i] != '\t') i++;
+        out[count++] = line.substr(start, i - start);
+    }
+    return count;
+}
+
+template <typename T>
+static bool parse_number(string_view token, T& out) {
+    if (token.empty()) return false;
+    auto [ptr, ec] = from_chars(token.data(), token.data() + token.size(), out);
+    return ec == errc() && ptr == token.data() + token.size();
+}
+
+bool parse_size(string_view token, size_t& out) {
+    return parse_number(token, out);
+}
+
+bool parse_int(string_view token, int& out) {
+    return parse_number(token, out);
+}
+
+bool parse_u64(string_view token, uint64_t& out) {
+    return parse_number(token, out);
+}
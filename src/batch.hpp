@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Reads a file descriptor in large chunks and hands out lines as views into
+// its buffer, so scripted command streams avoid per-token iostream calls.
+class LineReader {
+public:
+    explicit LineReader(int fd, size_t chunk_size = 1 << 20);
+
+    // Returns false at end of input. The view (without '\n' or '\r') is valid
+    // until the next call.
+    bool next_line(std::string_view& line);
+
+private:
+    bool fill();
+
+    int fd;
+    std::vector<char> buf;
+    size_t begin = 0;
+    size_t end = 0;
+    bool eof = false;
+};
+
+// Splits on spaces/tabs into at most `max` tokens; returns the token count.
+size_t split_tokens(std::string_view line, std::string_view* out, size_t max);
+
+// Strict decimal parsers for command arguments (no sign for sizes).
+bool parse_size(std::string_view token, size_t& out);
+bool parse_int(std::string_view token, int& out);
+bool parse_u64(std::string_view token, uint64_t& out);
@@ -0,0 +1,111 @@
+#include "heap_internal.hpp"
+#include <algorithm>
+
+using namespace std;
+
+// One bit per BITMAP_GRANULE bytes of the heap, set while the granule is
+// free. Bits past the end of the heap stay clear so searches stop there.
+// Granules inside the huge region or only partly covered by a free block
+// read as used.
+static vector<uint64_t> free_bits;
+static size_t granules = 0;
+static bool bitmap_valid = false;
+
+void invalidate_bitmap() {
+    bitmap_valid = false;
+}
+
+static void set_range(size_t first, size_t count, bool free) {
+    size_t last = first + count;   // exclusive
+    while (first < last) {
+        size_t bit = first % 64;
+        size_t n = min<size_t>(64 - bit, last - first);
+        uint64_t mask = (n == 64 ? ~0ULL : ((1ULL << n) - 1)) << bit;
+        if (free) free_bits[first / 64] |= mask;
+        else free_bits[first / 64] &= ~mask;
+        first += n;
+    }
+}
+
+void bitmap_mark_free(size_t start, size_t size) {
+    if (!bitmap_valid) return;
+    size_t first = (start + BITMAP_GRANULE - 1) / BITMAP_GRANULE;
+    size_t last = (start + size) / BITMAP_GRANULE;
+    if (last > first) set_range(first, last - first, true);
+}
+
+// Buddy only merges buddies and snapshots keep whatever layout they were
+// saved with, so neighbouring free blocks may be separate entries. The map
+// sees them as one run, and a run has to be one block for place_block().
+static void merge_free_neighbours() {
+    size_t out = 0;
+    for (size_t i = 0; i < memory.size(); ++i) {
+        if (out > 0 && !memory[i].used && !memory[out - 1].used &&
+            memory[out - 1].start + memory[out - 1].size == memory[i].start) {
+            memory[out - 1].size += memory[i].size;
+            continue;
+        }
+        memory[out++] = memory[i];
+    }
+    if (out == memory.size()) return;
+    memory.resize(out, Block(0, 0, false, 0));
+    invalidate_free_index();
+}
+
+static void rebuild_bitmap() {
+    merge_free_neighbours();
+    granules = heap_size / BITMAP_GRANULE;
+    free_bits.assign((granules + 63) / 64, 0);
+    bitmap_valid = true;
+    for (const auto& block : memory)
+        if (!block.used) bitmap_mark_free(block.start, block.size);
+}
+
+// Lowest granule starting a run of `n` free granules, or SIZE_MAX. Each
+// iteration jumps over a whole used run and a whole free run with one
+// count-trailing-zeros each, so the cost is per run, not per granule.
+static size_t find_run(size_t n) {
+    size_t words = free_bits.size();
+    size_t pos = 0;
+    while (pos < granules) {
+        size_t w = pos / 64;
+        uint64_t free = free_bits[w] & (~0ULL << (pos % 64));
+        while (free == 0) {
+            if (++w == words) return SIZE_MAX;
+            free = free_bits[w];
+        }
+        size_t run_start = w * 64 + __builtin_ctzll(free);
+
+        uint64_t used = ~free_bits[w] & (~0ULL << (run_start % 64));
+        while (used == 0 && ++w < words) used = ~free_bits[w];
+        size_t run_end = w == words ? granules : w * 64 + __builtin_ctzll(used);
+
+        if (run_end - run_start >= n) return run_start;
+        pos = run_end;
+    }
+    return SIZE_MAX;
+}
+
+int allocate_bitmap(size_t size) {
+    if (!bitmap_valid) rebuild_bitmap();
+    size_t n = max<size_t>(1, (size + BITMAP_GRANULE - 1) / BITMAP_GRANULE);
+    size_t run = find_run(n);
+    if (run == SIZE_MAX) return -1;
+
+    // the free block holding the run; it only starts mid-block when `memory`
+    // was laid out unaligned by another strategy
+    size_t start = run * BITMAP_GRANULE;
+    auto it = upper_bound(memory.begin(), memory.end(), start,
+                          [](size_t addr, const Block& b) { return addr < b.start; }) - 1;
+    size_t index = it - memory.begin();
+    if (memory[index].start < start) {
+        split_free_block(index, start - memory[index].start);
+        index++;
+    }
+    if (memory[index].size < n * BITMAP_GRANULE) return -1;   // map out of step
+
+    int id = take_id();
+    place_block(index, n * BITMAP_GRANULE, id);
+    set_range(run, n, false);
+    return id;
+}
@@ -0,0 +1,359 @@
+#include "block_tree.hpp"
+#include "workload.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+static const int MIN_LEAF = BlockTree::LEAF_CAP / 2;
+static const int MIN_CHILDREN = BlockTree::INNER_CAP / 2;
+
+Block& BlockTree::iterator::operator*() const {
+    return leaf->entries[pos];
+}
+
+Block* BlockTree::iterator::operator->() const {
+    return &leaf->entries[pos];
+}
+
+BlockTree::iterator& BlockTree::iterator::operator++() {
+    if (++pos >= leaf->count) {
+        leaf = leaf->next;
+        pos = 0;
+    }
+    return *this;
+}
+
+BlockTree::iterator& BlockTree::iterator::operator--() {
+    if (!leaf) {
+        leaf = tree->tail;
+        pos = leaf->count - 1;
+    } else if (pos > 0) {
+        pos--;
+    } else {
+        leaf = leaf->prev;
+        pos = leaf->count - 1;
+    }
+    return *this;
+}
+
+BlockTree::BlockTree() : root(nullptr), head(nullptr), tail(nullptr), count(0) {
+    clear();
+}
+
+BlockTree::~BlockTree() {
+    destroy(root);
+}
+
+BlockTree::Leaf* BlockTree::new_leaf() {
+    Leaf* leaf = new Leaf;
+    leaf->is_leaf = true;
+    leaf->count = 0;
+    leaf->prev = leaf->next = nullptr;
+    return leaf;
+}
+
+BlockTree::Inner* BlockTree::new_inner() {
+    Inner* inner = new Inner;
+    inner->is_leaf = false;
+    inner->count = 0;
+    return inner;
+}
+
+void BlockTree::destroy(Node* node) {
+    if (!node) return;
+    if (!node->is_leaf) {
+        Inner* inner = static_cast<Inner*>(node);
+        for (int i = 0; i < inner->count; ++i) destroy(inner->child[i]);
+        delete inner;
+    } else {
+        delete static_cast<Leaf*>(node);
+    }
+}
+
+void BlockTree::clear() {
+    destroy(root);
+    head = tail = new_leaf();
+    root = head;
+    count = 0;
+}
+
+int BlockTree::height() const {
+    int h = 1;
+    for (Node* n = root; !n->is_leaf; n = static_cast<Inner*>(n)->child[0]) h++;
+    return h;
+}
+
+int BlockTree::leaf_lower(const Leaf* leaf, size_t start) {
+    const Block* first = leaf->entries;
+    return std::lower_bound(first, first + leaf->count, start,
+        [](const Block& b, size_t key) { return b.start < key; }) - first;
+}
+
+int BlockTree::child_index(const Inner* inner, size_t start) {
+    return std::upper_bound(inner->keys, inner->keys + inner->count - 1, start) - inner->keys;
+}
+
+BlockTree::Leaf* BlockTree::leaf_for(size_t start) const {
+    Node* n = root;
+    while (!n->is_leaf) {
+        Inner* inner = static_cast<Inner*>(n);
+        n = inner->child[child_index(inner, start)];
+    }
+    return static_cast<Leaf*>(n);
+}
+
+BlockTree::iterator BlockTree::begin() const {
+    return count == 0 ? end() : iterator(this, head, 0);
+}
+
+BlockTree::iterator BlockTree::lower_bound(size_t start) const {
+    Leaf* leaf = leaf_for(start);
+    int pos = leaf_lower(leaf, start);
+    if (pos == leaf->count) return iterator(this, leaf->next, 0);
+    return iterator(this, leaf, pos);
+}
+
+BlockTree::iterator BlockTree::find(size_t start) const {
+    iterator it = lower_bound(start);
+    if (it == end() || it->start != start) return end();
+    return it;
+}
+
+BlockTree::iterator BlockTree::containing(size_t addr) const {
+    iterator it = lower_bound(addr);
+    if (it != end() && it->start == addr) return it;
+    if (it == begin()) return end();
+    --it;
+    return addr < it->start + it->size ? it : end();
+}
+
+bool BlockTree::insert_into(Node* node, const Block& block, SplitResult& split) {
+    if (node->is_leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        int pos = leaf_lower(leaf, block.start);
+        std::copy_backward(leaf->entries + pos, leaf->entries + leaf->count,
+                           leaf->entries + leaf->count + 1);
+        leaf->entries[pos] = block;
+        if (++leaf->count <= LEAF_CAP) return false;
+
+        Leaf* right = new_leaf();
+        int keep = leaf->count / 2;
+        right->count = leaf->count - keep;
+        std::copy(leaf->entries + keep, leaf->entries + leaf->count, right->entries);
+        leaf->count = keep;
+        right->next = leaf->next;
+        right->prev = leaf;
+        if (leaf->next) leaf->next->prev = right;
+        else tail = right;
+        leaf->next = right;
+        split = {right, right->entries[0].start};
+        return true;
+    }
+
+    Inner* inner = static_cast<Inner*>(node);
+    int idx = child_index(inner, block.start);
+    SplitResult child_split;
+    if (!insert_into(inner->child[idx], block, child_split)) return false;
+
+    std::copy_backward(inner->keys + idx, inner->keys + inner->count - 1, inner->keys + inner->count);
+    std::copy_backward(inner->child + idx + 1, inner->child + inner->count, inner->child + inner->count + 1);
+    inner->keys[idx] = child_split.separator;
+    inner->child[idx + 1] = child_split.right;
+    if (++inner->count <= INNER_CAP) return false;
+
+    // left keeps `keep` children; the key between the halves moves up
+    Inner* right = new_inner();
+    int keep = inner->count / 2;
+    right->count = inner->count - keep;
+    std::copy(inner->child + keep, inner->child + inner->count, right->child);
+    std::copy(inner->keys + keep, inner->keys + inner->count - 1, right->keys);
+    split = {right, inner->keys[keep - 1]};
+    inner->count = keep;
+    return true;
+}
+
+BlockTree::iterator BlockTree::insert(const Block& block) {
+    SplitResult split;
+    if (insert_into(root, block, split)) {
+        Inner* top = new_inner();
+        top->count = 2;
+        top->child[0] = root;
+        top->child[1] = split.right;
+        top->keys[0] = split.separator;
+        root = top;
+    }
+    count++;
+    return find(block.start);
+}
+
+void BlockTree::fix_child(Inner* parent, int idx) {
+    Node* c = parent->child[idx];
+    Node* left = idx > 0 ? parent->child[idx - 1] : nullptr;
+    Node* right = idx + 1 < parent->count ? parent->child[idx + 1] : nullptr;
+
+    if (c->is_leaf) {
+        Leaf* leaf = static_cast<Leaf*>(c);
+        Leaf* l = static_cast<Leaf*>(left);
+        Leaf* r = static_cast<Leaf*>(right);
+        if (l && l->count > MIN_LEAF) {
+            std::copy_backward(leaf->entries, leaf->entries + leaf->count, leaf->entries + leaf->count + 1);
+            leaf->entries[0] = l->entries[--l->count];
+            leaf->count++;
+            parent->keys[idx - 1] = leaf->entries[0].start;
+            return;
+        }
+        if (r && r->count > MIN_LEAF) {
+            leaf->entries[leaf->count++] = r->entries[0];
+            std::copy(r->entries + 1, r->entries + r->count, r->entries);
+            r->count--;
+            parent->keys[idx] = r->entries[0].start;
+            return;
+        }
+        // merge into the left node of the pair and drop the right one
+        Leaf* dst = l ? l : leaf;
+        Leaf* src = l ? leaf : r;
+        int sep = l ? idx - 1 : idx;
+        std::copy(src->entries, src->entries + src->count, dst->entries + dst->count);
+        dst->count += src->count;
+        dst->next = src->next;
+        if (src->next) src->next->prev = dst;
+        else tail = dst;
+        delete src;
+        std::copy(parent->keys + sep + 1, parent->keys + parent->count - 1, parent->keys + sep);
+        std::copy(parent->child + sep + 2, parent->child + parent->count, parent->child + sep + 1);
+        parent->count--;
+        return;
+    }
+
+    Inner* node = static_cast<Inner*>(c);
+    Inner* l = static_cast<Inner*>(left);
+    Inner* r = static_cast<Inner*>(right);
+    if (l && l->count > MIN_CHILDREN) {
+        // rotate right through the parent key
+        std::copy_backward(node->keys, node->keys + node->count - 1, node->keys + node->count);
+        std::copy_backward(node->child, node->child + node->count, node->child + node->count + 1);
+        node->keys[0] = parent->keys[idx - 1];
+        node->child[0] = l->child[l->count - 1];
+        parent->keys[idx - 1] = l->keys[l->count - 2];
+        l->count--;
+        node->count++;
+        return;
+    }
+    if (r && r->count > MIN_CHILDREN) {
+        // rotate left through the parent key
+        node->keys[node->count - 1] = parent->keys[idx];
+        node->child[node->count] = r->child[0];
+        parent->keys[idx] = r->keys[0];
+        std::copy(r->keys + 1, r->keys + r->count - 1, r->keys);
+        std::copy(r->child + 1, r->child + r->count, r->child);
+        r->count--;
+        node->count++;
+        return;
+    }
+    Inner* dst = l ? l : node;
+    Inner* src = l ? node : r;
+    int sep = l ? idx - 1 : idx;
+    dst->keys[dst->count - 1] = parent->keys[sep];
+    std::copy(src->keys, src->keys + src->count - 1, dst->keys + dst->count);
+    std::copy(src->child, src->child + src->count, dst->child + dst->count);
+    dst->count += src->count;
+    delete src;
+    std::copy(parent->keys + sep + 1, parent->keys + parent->count - 1, parent->keys + sep);
+    std::copy(parent->child + sep + 2, parent->child + parent->count, parent->child + sep + 1);
+    parent->count--;
+}
+
+bool BlockTree::erase_from(Node* node, size_t start) {
+    if (node->is_leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        int pos = leaf_lower(leaf, start);
+        if (pos == leaf->count || leaf->entries[pos].start != start) return false;
+        std::copy(leaf->entries + pos + 1, leaf->entries + leaf->count, leaf->entries + pos);
+        leaf->count--;
+        return true;
+    }
+
+    Inner* inner = static_cast<Inner*>(node);
+    int idx = child_index(inner, start);
+    if (!erase_from(inner->child[idx], start)) return false;
+    Node* c = inner->child[idx];
+    if (c->count < (c->is_leaf ? MIN_LEAF : MIN_CHILDREN)) fix_child(inner, idx);
+    return true;
+}
+
+bool BlockTree::erase(size_t start) {
+    if (!erase_from(root, start)) return false;
+    count--;
+    if (!root->is_leaf && root->count == 1) {
+        Inner* old = static_cast<Inner*>(root);
+        root = old->child[0];
+        delete old;
+    }
+    return true;
+}
+
+BlockTree::iterator BlockTree::split(iterator it, size_t first_size) {
+    size_t start = it->start;
+    size_t rest = it->size - first_size;
+    it->size = first_size;
+    insert(Block(start + first_size, rest, false, 0));
+    return find(start);
+}
+
+BlockTree::iterator BlockTree::merge_next(iterator it) {
+    size_t start = it->start;
+    iterator next = it;
+    ++next;
+    if (next == end()) return it;
+    size_t extra = next->size;
+    erase(next->start);
+    iterator cur = find(start);
+    cur->size += extra;
+    return cur;
+}
+
+void run_block_index_benchmark(size_t blocks, size_t ops) {
+    using namespace std::chrono;
+    const size_t block_size = 16;
+    size_t heap_bytes = blocks * block_size;
+
+    vector<Block> list;
+    list.reserve(blocks + 1);
+    BlockTree tree;
+    for (size_t i = 0; i < blocks; ++i) {
+        list.push_back(Block(i * block_size, block_size, true, (int)i + 1));
+        tree.insert(list.back());
+    }
+
+    // each op splits a random block in two, then merges the halves back:
+    // one insert and one erase at a random address
+    Xoshiro256 rng(1);
+    auto t0 = high_resolution_clock::now();
+    for (size_t op = 0; op < ops; ++op) {
+        size_t addr = rng.below(heap_bytes);
+        auto it = std::upper_bound(list.begin(), list.end(), addr,
+            [](size_t key, const Block& b) { return key < b.start; }) - 1;
+        size_t idx = it - list.begin();
+        list[idx].size = block_size / 2;
+        list.insert(list.begin() + idx + 1, Block(it->start + block_size / 2, block_size / 2, false, 0));
+        list[idx].size += list[idx + 1].size;
+        list.erase(list.begin() + idx + 1);
+    }
+    auto t1 = high_resolution_clock::now();
+
+    rng = Xoshiro256(1);
+    for (size_t op = 0; op < ops; ++op) {
+        auto it = tree.containing(rng.below(heap_bytes));
+        it = tree.split(it, block_size / 2);
+        tree.merge_next(it);
+    }
+    auto t2 = high_resolution_clock::now();
+
+    cout << "[Block Index Benchmark] Blocks=" << blocks << " Ops=" << ops << "\n"
+         << "  vector : " << duration_cast<microseconds>(t1 - t0).count() << " us\n"
+         << "  B+tree : " << duration_cast<microseconds>(t2 - t1).count() << " us"
+         << " (height " << tree.height() << ")\n";
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstddef>
+#include "allocator.hpp"
+
+// Address-ordered B+tree of Block metadata for heaps with millions of blocks.
+// Blocks live in wide leaves (LEAF_CAP entries, a few cache lines each) that
+// are chained for ordered iteration; inner nodes hold only start addresses.
+// Insert, erase, split and merge are O(log n) with at most one node
+// rebalanced per level, and neighbours for coalescing are an iterator step.
+// Standalone: the allocator still keeps `memory` in a vector; this container
+// is exercised by its tests and run_block_index_benchmark().
+class BlockTree {
+public:
+    static constexpr int LEAF_CAP = 32;
+    static constexpr int INNER_CAP = 32;   // max children per inner node
+
+private:
+    struct Node;
+    struct Leaf;
+    struct Inner;
+
+public:
+    class iterator {
+    public:
+        iterator() = default;
+        Block& operator*() const;
+        Block* operator->() const;
+        iterator& operator++();
+        iterator& operator--();
+        bool operator==(const iterator& o) const { return leaf == o.leaf && pos == o.pos; }
+        bool operator!=(const iterator& o) const { return !(*this == o); }
+
+    private:
+        friend class BlockTree;
+        iterator(const BlockTree* t, Leaf* l, int p) : tree(t), leaf(l), pos(p) {}
+        const BlockTree* tree = nullptr;
+        Leaf* leaf = nullptr;   // nullptr = end()
+        int pos = 0;
+    };
+
+    BlockTree();
+    ~BlockTree();
+    BlockTree(const BlockTree&) = delete;
+    BlockTree& operator=(const BlockTree&) = delete;
+
+    void clear();
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    int height() const;
+
+    iterator begin() const;
+    iterator end() const { return iterator(this, nullptr, 0); }
+    iterator find(size_t start) const;          // block starting exactly at start
+    iterator lower_bound(size_t start) const;   // first block with start >= key
+    iterator containing(size_t addr) const;     // block whose range covers addr
+
+    iterator insert(const Block& block);        // start must be unique
+    bool erase(size_t start);
+
+    // Shrinks the block at `it` to `first_size` and inserts the remainder as a
+    // free block right after it.
+    iterator split(iterator it, size_t first_size);
+    // Absorbs the following block into the one at `it`.
+    iterator merge_next(iterator it);
+
+private:
+    struct Node {
+        bool is_leaf;
+        int count;
+    };
+    struct Leaf : Node {
+        Block entries[LEAF_CAP + 1];   // one spare slot for the overflow before a split
+        Leaf* prev;
+        Leaf* next;
+    };
+    struct Inner : Node {
+        size_t keys[INNER_CAP];        // keys[i] separates child[i] and child[i + 1]
+        Node* child[INNER_CAP + 1];
+    };
+
+    struct SplitResult {
+        Node* right;
+        size_t separator;
+    };
+
+    static Leaf* new_leaf();
+    static Inner* new_inner();
+    static void destroy(Node* node);
+    static int leaf_lower(const Leaf* leaf, size_t start);
+    static int child_index(const Inner* inner, size_t start);
+
+    bool insert_into(Node* node, const Block& block, SplitResult& split);
+    bool erase_from(Node* node, size_t start);
+    void fix_child(Inner* parent, int idx);
+    Leaf* leaf_for(size_t start) const;
+
+    Node* root;
+    Leaf* head;
+    Leaf* tail;
+    size_t count;
+};
+
+// Times split/merge churn on an n-block heap held in a std::vector versus a
+// BlockTree and prints both, to size the win on very large heaps.
+void run_block_index_benchmark(size_t blocks, size_t ops);
@@ -0,0 +1,82 @@
+#include "cache_sim.hpp"
+#include <algorithm>
+
+using namespace std;
+
+static CacheSimConfig sim_config;
+static bool sim_enabled = false;
+
+CacheLevel::CacheLevel(size_t size, size_t ways, size_t line)
+    : sets(size / line / ways), ways(ways),
+      tags(sets * ways, 0), stamps(sets * ways, 0) {}
+
+bool CacheLevel::access(uint64_t line) {
+    size_t base = line % sets * ways;
+    size_t victim = base;
+    clock++;
+    for (size_t w = base; w < base + ways; ++w) {
+        if (tags[w] == line + 1) {
+            stamps[w] = clock;
+            hits++;
+            return true;
+        }
+        if (stamps[w] < stamps[victim]) victim = w;
+    }
+    // empty ways have stamp 0, so they are filled before anything is evicted
+    tags[victim] = line + 1;
+    stamps[victim] = clock;
+    misses++;
+    return false;
+}
+
+void CacheLevel::clear() {
+    fill(tags.begin(), tags.end(), 0);
+    fill(stamps.begin(), stamps.end(), 0);
+    clock = 0;
+    hits = 0;
+    misses = 0;
+}
+
+CacheSim::CacheSim(const CacheSimConfig& config)
+    : line(config.line),
+      l1(config.l1_size, config.l1_ways, config.line),
+      l2(config.l2_size, config.l2_ways, config.line) {}
+
+void CacheSim::access(size_t addr, size_t bytes) {
+    if (bytes == 0) return;
+    for (uint64_t l = addr / line; l <= (addr + bytes - 1) / line; ++l)
+        if (!l1.access(l)) l2.access(l);
+}
+
+void CacheSim::clear() {
+    l1.clear();
+    l2.clear();
+}
+
+CacheSimStats CacheSim::stats() const {
+    CacheSimStats s{};
+    s.accesses = l1.hits + l1.misses;
+    s.memory_reads = l2.misses;
+    if (s.accesses) s.l1_hit_rate = (double)l1.hits / s.accesses;
+    if (l1.misses) s.l2_hit_rate = (double)l2.hits / l1.misses;
+    return s;
+}
+
+bool set_cache_simulation(const CacheSimConfig& config) {
+    size_t line = config.line;
+    if (line == 0 || (line & (line - 1)) != 0) return false;
+    if (config.l1_ways == 0 || config.l1_size < line * config.l1_ways) return false;
+    if (config.l2_ways == 0 || config.l2_size < line * config.l2_ways) return false;
+    if (config.touches < 0) return false;
+    sim_config = config;
+    sim_enabled = true;
+    return true;
+}
+
+void disable_cache_simulation() {
+    sim_enabled = false;
+}
+
+const CacheSimConfig* cache_simulation() {
+    return sim_enabled ? &sim_config : nullptr;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Trace-driven model of a two-level, set-associative CPU cache with LRU
+// replacement, used to score how well a placement strategy keeps objects that
+// are used together on the same lines. Addresses are heap offsets; nothing is
+// actually read. The defaults are scaled to the 1 KiB simulated heap (the heap
+// is 64 lines of 16 bytes, L1 holds 8 of them and L2 32) so that placement
+// still matters; real-sized caches would hold the whole heap.
+
+// How the benchmark touches live objects after each operation.
+enum AccessPattern {
+    RecentWalk,    // the most recent live allocations, newest first
+    RandomLive     // live allocations picked at random
+};
+
+struct CacheSimConfig {
+    size_t line = 16;          // bytes, power of two
+    size_t l1_size = 128;
+    size_t l1_ways = 2;
+    size_t l2_size = 512;
+    size_t l2_ways = 4;
+    AccessPattern pattern = RecentWalk;
+    int touches = 8;           // objects read after each operation
+};
+
+class CacheLevel {
+public:
+    CacheLevel(size_t size, size_t ways, size_t line);
+
+    // Looks up a line number, filling it on a miss; true on a hit.
+    bool access(uint64_t line);
+    void clear();
+
+    size_t hits = 0;
+    size_t misses = 0;
+
+private:
+    size_t sets;
+    size_t ways;
+    std::vector<uint64_t> tags;     // sets * ways, line number + 1 (0 = empty)
+    std::vector<uint64_t> stamps;   // last use, for LRU
+    uint64_t clock = 0;
+};
+
+struct CacheSimStats {
+    size_t accesses;       // line accesses
+    double l1_hit_rate;
+    double l2_hit_rate;    // of the L1 misses
+    size_t memory_reads;   // misses in both levels
+};
+
+// L1 backed by L2; an L1 miss looks in L2 and the line is filled in both.
+class CacheSim {
+public:
+    explicit CacheSim(const CacheSimConfig& config = {});
+
+    // Touches every line of [addr, addr + bytes).
+    void access(size_t addr, size_t bytes);
+    void clear();
+    CacheSimStats stats() const;
+
+private:
+    size_t line;
+    CacheLevel l1;
+    CacheLevel l2;
+};
+
+// Turns the simulator on for run_benchmarks(): each strategy's run writes its
+// new blocks and reads `touches` live ones after every operation, and the
+// L1/L2 hit rates are reported per strategy. Returns false for a line size
+// that is not a power of two or a level smaller than one set.
+bool set_cache_simulation(const CacheSimConfig& config);
+void disable_cache_simulation();
+// Current configuration, or nullptr when off.
+const CacheSimConfig* cache_simulation();
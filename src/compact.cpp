@@ -0,0 +1,82 @@
+#include "heap_internal.hpp"
+#include <iostream>
+
+using namespace std;
+
+static_assert(sizeof(CompactBlock) == 12, "CompactBlock must stay 12 bytes");
+
+static size_t granule = 1;
+static unsigned granule_shift = 0;
+
+bool set_granule(size_t bytes) {
+    if (bytes == 0 || bytes > SIM_PAGE_SIZE || (bytes & (bytes - 1)) != 0) return false;
+    granule = bytes;
+    granule_shift = __builtin_ctzll(bytes);
+    return true;
+}
+
+size_t get_granule() {
+    return granule;
+}
+
+size_t round_to_granule(size_t size) {
+    return (size + granule - 1) & ~(granule - 1);
+}
+
+static bool fits_compact(const Block& block) {
+    return ((block.start | block.size) & (granule - 1)) == 0 &&
+           (block.start >> granule_shift) <= UINT32_MAX &&
+           (block.size >> granule_shift) <= (UINT32_MAX >> 1);
+}
+
+bool pack_blocks(vector<CompactBlock>& out) {
+    out.clear();
+    out.reserve(memory.size());
+    for (const auto& block : memory) {
+        if (!fits_compact(block)) return false;
+        uint32_t size = block.size >> granule_shift;
+        out.push_back({(uint32_t)(block.start >> granule_shift),
+                       size << 1 | (block.used ? 1u : 0u), block.id});
+    }
+    return true;
+}
+
+void unpack_blocks(const vector<CompactBlock>& in) {
+    memory.clear();
+    memory.reserve(in.size());
+    for (const auto& c : in)
+        memory.push_back(Block((size_t)c.start << granule_shift, c.granules() << granule_shift,
+                               c.used(), c.id));
+    invalidate_free_index();
+}
+
+MetadataStats get_metadata_stats() {
+    MetadataStats stats{};
+    stats.records = memory.size();
+    bool packable = true;
+    for (const auto& block : memory) {
+        if (block.used && block.id != SLAB_BLOCK_ID) stats.live_allocs++;
+        packable = packable && fits_compact(block);
+    }
+    // small objects and huge spans are live allocations without a record
+    stats.live_allocs += get_hybrid_stats().live_objects + get_huge_stats().used_spans;
+    stats.block_bytes = stats.records * sizeof(Block);
+    stats.compact_bytes = packable ? stats.records * sizeof(CompactBlock) : 0;
+    if (stats.live_allocs > 0) {
+        stats.per_alloc = (double)stats.block_bytes / stats.live_allocs;
+        stats.compact_per_alloc = (double)stats.compact_bytes / stats.live_allocs;
+    }
+    return stats;
+}
+
+void show_metadata_stats() {
+    MetadataStats stats = get_metadata_stats();
+    cout << "Metadata              : " << stats.block_bytes << " bytes in " << stats.records
+         << " records (" << stats.per_alloc << " per live allocation)\n";
+    cout << "Compact Metadata      : ";
+    if (stats.compact_bytes > 0)
+        cout << stats.compact_bytes << " bytes (" << stats.compact_per_alloc
+             << " per live allocation, granule " << granule << ")\n";
+    else
+        cout << "n/a (blocks not " << granule << "-byte aligned)\n";
+}
@@ -0,0 +1,90 @@
+#include "heap_internal.hpp"
+
+using namespace std;
+
+struct HandleSlot {
+    uint32_t generation;   // odd while the slot is live
+    int id;
+    size_t offset;
+};
+
+// Slots are never removed, only recycled through free_slots, so the table
+// stays as large as the peak number of live handles.
+static vector<HandleSlot> slots;
+static vector<uint32_t> free_slots;
+
+static Handle make_handle(uint32_t index, uint32_t generation) {
+    return (Handle)generation << 32 | index;
+}
+
+// Live slot named by `handle`, or nullptr for a stale or malformed handle.
+static HandleSlot* lookup(Handle handle) {
+    uint32_t index = handle & 0xFFFFFFFF;
+    uint32_t generation = handle >> 32;
+    if (index >= slots.size()) return nullptr;
+    HandleSlot& slot = slots[index];
+    if (slot.generation != generation || !(generation & 1)) return nullptr;
+    return &slot;
+}
+
+static void retire(uint32_t index) {
+    slots[index].generation++;   // back to even: every old handle is now stale
+    free_slots.push_back(index);
+}
+
+void reset_handles() {
+    // keep the generations so handles from before the reset stay stale
+    free_slots.clear();
+    for (uint32_t i = slots.size(); i-- > 0;) {
+        if (slots[i].generation & 1) slots[i].generation++;
+        free_slots.push_back(i);
+    }
+}
+
+Handle allocate_handle(size_t size) {
+    size_t offset;
+    int id = allocate(size, offset);
+    if (id == -1) return NULL_HANDLE;
+
+    uint32_t index;
+    if (!free_slots.empty()) {
+        index = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        index = slots.size();
+        slots.push_back({0, 0, 0});
+    }
+    HandleSlot& slot = slots[index];
+    slot.generation++;
+    slot.id = id;
+    slot.offset = offset;
+    return make_handle(index, slot.generation);
+}
+
+bool free_handle(Handle handle) {
+    HandleSlot* slot = lookup(handle);
+    if (!slot) return false;
+    // the block may have been freed by id behind the handle's back
+    bool freed = id_at(slot->offset) == slot->id && free_at(slot->offset);
+    retire(slot - slots.data());
+    return freed;
+}
+
+bool handle_valid(Handle handle) {
+    HandleSlot* slot = lookup(handle);
+    return slot && id_at(slot->offset) == slot->id;
+}
+
+int handle_id(Handle handle) {
+    HandleSlot* slot = lookup(handle);
+    return slot ? slot->id : 0;
+}
+
+size_t handle_offset(Handle handle) {
+    HandleSlot* slot = lookup(handle);
+    return slot ? slot->offset : SIZE_MAX;
+}
+
+size_t handle_slots() {
+    return slots.size();
+}
@@ -0,0 +1,126 @@
+#pragma once
+// Helpers shared by the allocator translation units; not part of the public API.
+#include "allocator.hpp"
+
+// Block id that marks a slab carved out for the hybrid small-object path.
+constexpr int SLAB_BLOCK_ID = -1;
+
+// Allocation ids: take_id() reissues freed ids before advancing next_id, and
+// every path that frees an allocation hands its id to recycle_id().
+int take_id();
+void recycle_id(int id);
+// True once next_id has reached INT_MAX with no freed id to reissue; every
+// allocation then fails.
+bool ids_exhausted();
+
+// initialize_memory() for a heap of `bytes`: drops every side structure
+// (slabs, huge spans, handles, arenas, caches, ...) along with the blocks.
+void reset_heap(size_t bytes);
+
+// Index of the free block a fit policy would pick for `size`, or -1.
+int find_fit(size_t size, AllocationStrategy fit);
+// Marks memory[index] used for `size` bytes and splits off the remainder.
+void place_block(size_t index, size_t size, int id);
+// find_fit + place_block with a fresh id; -1 on failure.
+int allocate_fit(size_t size, AllocationStrategy fit);
+// Marks memory[index] free and coalesces it under the current strategy.
+void release_block(size_t index);
+// Drops the derived free-space indexes (the size-ordered set and the Bitmap
+// strategy's granule map) after a bulk edit of `memory`; the next lookup
+// rebuilds them.
+void invalidate_free_index();
+// Splits free block memory[index] into two free blocks, the first
+// `first_size` bytes long, keeping the free index in step.
+void split_free_block(size_t index, size_t first_size);
+// Binary search of the address-ordered block list; -1 if no block starts there.
+int find_block_at(size_t start);
+
+size_t next_power_of_two(size_t n);
+
+// Start of the most recent successful allocation, set by every allocation
+// path; read by allocate(size, offset).
+extern size_t last_alloc_offset;
+
+// Hybrid small-object path (hybrid.cpp)
+int allocate_hybrid(size_t size);
+// `size` (0 = unknown) must fit the object, as in free_small_at().
+bool free_small(int id, size_t size);
+// Frees the slot at `offset` in the slab whose block starts at `slab_start`;
+// `size` (0 = unknown) must fit the slot.
+bool free_small_at(size_t slab_start, size_t offset, size_t size);
+int small_id_at(size_t slab_start, size_t offset);
+void reset_hybrid();
+void show_hybrid_stats();
+
+// Size profiling (size_profile.cpp)
+void profile_request(size_t size);
+void load_startup_size_classes();
+
+// Bitmap strategy (bitmap.cpp)
+int allocate_bitmap(size_t size);
+void bitmap_mark_free(size_t start, size_t size);
+void invalidate_bitmap();
+
+// Stack strategy (stack.cpp)
+int allocate_stack(size_t size);
+// Index of the most recent live allocation in `memory`, or -1.
+int stack_top_index();
+
+// Huge-allocation region (huge.cpp)
+bool huge_enabled();
+bool is_huge_request(size_t size);
+int allocate_huge(size_t size);
+bool free_huge(int id, size_t size);
+bool in_huge_region(size_t offset);
+bool free_huge_at(size_t offset, size_t size);
+int huge_id_at(size_t offset);
+void reset_huge();
+void show_huge_spans();
+void show_huge_stats();
+void fill_huge_ascii(std::vector<char>& canvas);
+
+// Page residency (residency.cpp)
+void reset_residency();
+void resize_residency(size_t bytes);
+void residency_tick();
+void pages_touch(size_t start, size_t size);
+void pages_release(size_t start, size_t size);
+void show_residency_stats();
+
+// Id of the live allocation starting at `offset`, or 0.
+int id_at(size_t offset);
+
+// Handles (handles.cpp)
+void reset_handles();
+
+// Object caches (object_cache.cpp)
+void reset_caches();
+void show_cache_stats();
+
+// Arenas (arena.cpp)
+void reset_arenas();
+void show_arena_stats();
+
+// Co-allocation hints (locality.cpp)
+void reset_locality();
+void show_locality_stats();
+
+// Tracing (trace.cpp). Callers test `tracing` first, so a disabled trace
+// costs one branch per operation.
+enum TraceKind {
+    TraceAllocate, TraceFree, TraceFreeAt, TraceSplit, TraceMerge,
+    TraceGrow, TraceTrim, TraceHeap
+};
+extern bool tracing;
+uint64_t trace_now();
+// `start` is the trace_now() taken on entry, for duration events.
+void trace_record(TraceKind kind, uint64_t start, int64_t a, int64_t b, int64_t c);
+// Keeps the bytes in used blocks up to date, emits them as a counter, and
+// recounts them after a bulk edit of `memory`.
+void trace_used(long long delta);
+void trace_heap();
+void trace_recount();
+
+// Compact metadata (compact.cpp)
+size_t round_to_granule(size_t size);
+void show_metadata_stats();
@@ -0,0 +1,218 @@
+#include "heap_internal.hpp"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+struct HugeSpan {
+    size_t start;
+    size_t pages;
+    bool used;
+    int id;
+};
+
+static size_t huge_threshold = 0;      // 0 = region disabled
+static size_t region_start = 0;
+static size_t region_bytes = 0;
+static vector<HugeSpan> spans;         // address-ordered, covers the region
+static size_t huge_allocs = 0;
+static size_t huge_failures = 0;
+
+bool huge_enabled() {
+    return huge_threshold > 0;
+}
+
+bool is_huge_request(size_t size) {
+    return huge_threshold > 0 && size >= huge_threshold;
+}
+
+void reset_huge() {
+    // initialize_memory() rebuilds the general heap over the full range, which
+    // may be smaller than when the region was set; carve the region again from
+    // the current top if one is configured and still fits
+    spans.clear();
+    huge_allocs = 0;
+    huge_failures = 0;
+    if (huge_threshold == 0) return;
+
+    Block& top = memory.back();
+    if (top.used || top.size <= region_bytes) {
+        huge_threshold = 0;
+        region_bytes = 0;
+        return;
+    }
+    top.size -= region_bytes;
+    region_start = top.start + top.size;
+    invalidate_free_index();
+    spans.push_back({region_start, region_bytes / SIM_PAGE_SIZE, false, 0});
+}
+
+// Hands the region back to the general heap at its own address, merging with
+// whichever neighbours are free and adjacent.
+static void return_region() {
+    auto it = lower_bound(memory.begin(), memory.end(), region_start,
+                          [](const Block& b, size_t key) { return b.start < key; });
+    size_t i = memory.insert(it, Block(region_start, region_bytes, false, 0)) - memory.begin();
+    if (i + 1 < memory.size() && !memory[i + 1].used &&
+        memory[i].start + memory[i].size == memory[i + 1].start) {
+        memory[i].size += memory[i + 1].size;
+        memory.erase(memory.begin() + i + 1);
+    }
+    if (i > 0 && !memory[i - 1].used &&
+        memory[i - 1].start + memory[i - 1].size == memory[i].start) {
+        memory[i - 1].size += memory[i].size;
+        memory.erase(memory.begin() + i);
+    }
+    invalidate_free_index();
+}
+
+bool set_huge_region(size_t threshold, size_t bytes) {
+    for (const auto& span : spans)
+        if (span.used) return false;
+
+    // hand any existing region back to the general heap first
+    if (huge_threshold > 0) {
+        return_region();
+        spans.clear();
+        huge_threshold = 0;
+        region_bytes = 0;
+    }
+    if (threshold == 0 || bytes == 0) return true;
+    if (current_strategy == Buddy) return false;   // needs a power-of-two heap
+
+    bytes = (bytes + SIM_PAGE_SIZE - 1) / SIM_PAGE_SIZE * SIM_PAGE_SIZE;
+    if (memory.empty() || memory.back().used || memory.back().size < bytes) return false;
+
+    Block& top = memory.back();
+    region_start = top.start + top.size - bytes;
+    top.size -= bytes;
+    if (top.size == 0) memory.pop_back();
+    invalidate_free_index();
+
+    huge_threshold = threshold;
+    region_bytes = bytes;
+    spans.push_back({region_start, bytes / SIM_PAGE_SIZE, false, 0});
+    return true;
+}
+
+int allocate_huge(size_t size) {
+    size_t pages = (size + SIM_PAGE_SIZE - 1) / SIM_PAGE_SIZE;
+    for (size_t i = 0; i < spans.size(); ++i) {
+        if (spans[i].used || spans[i].pages < pages) continue;
+
+        if (spans[i].pages > pages) {
+            HugeSpan rest{spans[i].start + pages * SIM_PAGE_SIZE, spans[i].pages - pages, false, 0};
+            spans[i].pages = pages;
+            spans.insert(spans.begin() + i + 1, rest);
+        }
+        spans[i].used = true;
+        spans[i].id = take_id();
+        last_alloc_offset = spans[i].start;
+        pages_touch(spans[i].start, pages * SIM_PAGE_SIZE);
+        if (tracing) trace_used(pages * SIM_PAGE_SIZE);
+        huge_allocs++;
+        return spans[i].id;
+    }
+    huge_failures++;
+    return -1;
+}
+
+static void release_span(size_t i) {
+    pages_release(spans[i].start, spans[i].pages * SIM_PAGE_SIZE);
+    if (tracing) trace_used(-(long long)(spans[i].pages * SIM_PAGE_SIZE));
+    spans[i].used = false;
+    recycle_id(spans[i].id);
+    spans[i].id = 0;
+    if (i + 1 < spans.size() && !spans[i + 1].used) {
+        spans[i].pages += spans[i + 1].pages;
+        spans.erase(spans.begin() + i + 1);
+    }
+    if (i > 0 && !spans[i - 1].used) {
+        spans[i - 1].pages += spans[i].pages;
+        spans.erase(spans.begin() + i);
+    }
+}
+
+bool free_huge(int id, size_t size) {
+    for (size_t i = 0; i < spans.size(); ++i) {
+        if (spans[i].id != id || !spans[i].used) continue;
+        if (size > spans[i].pages * SIM_PAGE_SIZE) return false;
+        release_span(i);
+        return true;
+    }
+    return false;
+}
+
+bool in_huge_region(size_t offset) {
+    return huge_threshold > 0 && offset >= region_start && offset < region_start + region_bytes;
+}
+
+// spans are address-ordered, so the owner is a binary search away
+static vector<HugeSpan>::iterator span_at(size_t offset) {
+    auto it = lower_bound(spans.begin(), spans.end(), offset,
+                          [](const HugeSpan& s, size_t key) { return s.start < key; });
+    if (it == spans.end() || it->start != offset || !it->used) return spans.end();
+    return it;
+}
+
+int huge_id_at(size_t offset) {
+    auto it = span_at(offset);
+    return it == spans.end() ? 0 : it->id;
+}
+
+bool free_huge_at(size_t offset, size_t size) {
+    auto it = span_at(offset);
+    if (it == spans.end()) return false;
+    if (size > it->pages * SIM_PAGE_SIZE) return false;
+    release_span(it - spans.begin());
+    return true;
+}
+
+HugeStats get_huge_stats() {
+    HugeStats stats{};
+    stats.threshold = huge_threshold;
+    stats.region_start = region_start;
+    stats.region_bytes = region_bytes;
+    for (const auto& span : spans) {
+        size_t bytes = span.pages * SIM_PAGE_SIZE;
+        if (span.used) {
+            stats.used_spans++;
+            stats.used_bytes += bytes;
+        } else {
+            stats.free_bytes += bytes;
+            stats.largest_free = max(stats.largest_free, bytes);
+        }
+    }
+    stats.allocs = huge_allocs;
+    stats.failures = huge_failures;
+    return stats;
+}
+
+void show_huge_spans() {
+    for (const auto& span : spans) {
+        size_t bytes = span.pages * SIM_PAGE_SIZE;
+        cout << "[" << span.start << " - " << (span.start + bytes - 1) << "] Huge "
+             << (span.used ? "Used (ID: " + to_string(span.id) + ")" : string("Free"))
+             << " Pages: " << span.pages << "\n";
+    }
+}
+
+void fill_huge_ascii(vector<char>& canvas) {
+    int width = canvas.size();
+    for (const auto& span : spans) {
+        int start = (span.start * width) / heap_size;
+        int end = ((span.start + span.pages * SIM_PAGE_SIZE) * width) / heap_size;
+        for (int i = start; i < end && i < width; i++)
+            canvas[i] = span.used ? 'H' : ',';
+    }
+}
+
+void show_huge_stats() {
+    HugeStats stats = get_huge_stats();
+    cout << "\n[Huge Region] (threshold " << stats.threshold << " bytes, "
+         << stats.region_bytes << " bytes at " << stats.region_start << ")\n";
+    cout << "Used Spans            : " << stats.used_spans << " (" << stats.used_bytes << " bytes)\n";
+    cout << "Free Bytes            : " << stats.free_bytes << "\n";
+    cout << "Largest Free Span     : " << stats.largest_free << " bytes\n";
+    cout << "Allocations / Failures: " << stats.allocs << " / " << stats.failures << "\n";
+}
@@ -0,0 +1,280 @@
+#include "heap_internal.hpp"
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+
+using namespace std;
+
+// Target slab footprint; each slab holds between 2 and 64 objects of one class
+// so its occupancy fits in a single 64-bit mask.
+static const size_t SLAB_TARGET_BYTES = 128;
+static const size_t MIN_SLAB_OBJECTS = 2;
+static const size_t MAX_SLAB_OBJECTS = 64;
+static const size_t DEFAULT_SMALL_THRESHOLD = 64;
+
+struct Slab {
+    size_t start;
+    size_t obj_size;
+    uint32_t capacity;
+    uint32_t size_class;
+    uint64_t free_mask;     // bit set = slot free
+    size_t partial_pos;     // position in partial[size_class], or SIZE_MAX
+    bool live;
+    int slot_id[MAX_SLAB_OBJECTS];   // owner of each allocated slot, for frees by offset
+};
+
+struct SmallObject {
+    uint32_t slab;
+    uint32_t slot;
+    size_t requested;
+};
+
+static vector<size_t> classes;
+static bool classes_configured = false;
+static vector<uint16_t> class_lut;   // request size -> class index
+static vector<Slab> slabs;
+static vector<uint32_t> spare_slabs;
+static vector<vector<uint32_t>> partial;   // per class: slabs with a free slot
+static unordered_map<int, SmallObject> small_objects;
+static unordered_map<size_t, uint32_t> slab_at;   // slab block start -> slab index
+static size_t small_allocs = 0;
+static size_t large_allocs = 0;
+
+static void build_lut() {
+    size_t threshold = classes.empty() ? 0 : classes.back();
+    class_lut.assign(threshold + 1, 0);
+    size_t c = 0;
+    for (size_t size = 1; size <= threshold; ++size) {
+        while (classes[c] < size) c++;
+        class_lut[size] = c;
+    }
+    partial.assign(classes.size(), {});
+}
+
+static vector<size_t> default_classes(size_t threshold) {
+    // 8-byte steps up to 32, then two classes per doubling (48, 64, 96, 128, ...)
+    vector<size_t> out;
+    for (size_t c = 8; c <= 32 && c <= threshold; c += 8) out.push_back(c);
+    for (size_t p = 32; p * 2 <= threshold; p *= 2) {
+        out.push_back(p + p / 2);
+        out.push_back(p * 2);
+    }
+    while (!out.empty() && out.back() > threshold) out.pop_back();
+    if (threshold > 0 && (out.empty() || out.back() < threshold)) out.push_back(threshold);
+    return out;
+}
+
+size_t max_small_threshold() {
+    return heap_size / MIN_SLAB_OBJECTS;
+}
+
+bool set_size_classes(const vector<size_t>& sizes) {
+    if (!small_objects.empty()) return false;
+    vector<size_t> sorted = sizes;
+    sort(sorted.begin(), sorted.end());
+    sorted.erase(unique(sorted.begin(), sorted.end()), sorted.end());
+    if (!sorted.empty() && sorted.front() == 0) return false;
+    // the lookup table has an entry per byte up to the largest class, and a
+    // class whose slab cannot fit in the heap would only ever fail
+    if (!sorted.empty() && sorted.back() > max_small_threshold()) return false;
+
+    // classes change slab geometry, so drop any (empty) cached slabs first
+    reset_hybrid();
+    classes = sorted;
+    classes_configured = true;
+    build_lut();
+    return true;
+}
+
+bool set_small_threshold(size_t bytes) {
+    return set_size_classes(default_classes(bytes));
+}
+
+const vector<size_t>& get_size_classes() {
+    if (!classes_configured) set_small_threshold(DEFAULT_SMALL_THRESHOLD);
+    return classes;
+}
+
+void reset_hybrid() {
+    slabs.clear();
+    spare_slabs.clear();
+    small_objects.clear();
+    slab_at.clear();
+    for (auto& list : partial) list.clear();
+    small_allocs = 0;
+    large_allocs = 0;
+}
+
+static void partial_push(uint32_t index) {
+    Slab& slab = slabs[index];
+    slab.partial_pos = partial[slab.size_class].size();
+    partial[slab.size_class].push_back(index);
+}
+
+static void partial_remove(uint32_t index) {
+    Slab& slab = slabs[index];
+    auto& list = partial[slab.size_class];
+    uint32_t moved = list.back();
+    list[slab.partial_pos] = moved;
+    slabs[moved].partial_pos = slab.partial_pos;
+    list.pop_back();
+    slab.partial_pos = SIZE_MAX;
+}
+
+static int new_slab(uint32_t size_class) {
+    size_t obj_size = classes[size_class];
+    size_t capacity = clamp(SLAB_TARGET_BYTES / obj_size, MIN_SLAB_OBJECTS, MAX_SLAB_OBJECTS);
+
+    int index = find_fit(obj_size * capacity, FirstFit);
+    if (index == -1) return -1;
+    size_t start = memory[index].start;
+    place_block(index, obj_size * capacity, SLAB_BLOCK_ID);
+
+    uint32_t slab_index;
+    if (!spare_slabs.empty()) {
+        slab_index = spare_slabs.back();
+        spare_slabs.pop_back();
+    } else {
+        slab_index = slabs.size();
+        slabs.emplace_back();
+    }
+    uint64_t mask = capacity == 64 ? ~0ULL : ((1ULL << capacity) - 1);
+    slabs[slab_index] = Slab{start, obj_size, (uint32_t)capacity, size_class, mask, SIZE_MAX, true, {}};
+    slab_at[start] = slab_index;
+    partial_push(slab_index);
+    return slab_index;
+}
+
+int allocate_hybrid(size_t size) {
+    const vector<size_t>& sizes = get_size_classes();
+    if (size == 0 || sizes.empty() || size > sizes.back()) {
+        int id = allocate_fit(size, FirstFit);
+        if (id != -1) large_allocs++;
+        return id;
+    }
+
+    uint32_t size_class = class_lut[size];
+    uint32_t slab_index;
+    if (!partial[size_class].empty()) {
+        slab_index = partial[size_class].back();
+    } else {
+        int created = new_slab(size_class);
+        if (created == -1) return -1;
+        slab_index = created;
+    }
+
+    Slab& slab = slabs[slab_index];
+    uint32_t slot = __builtin_ctzll(slab.free_mask);
+    slab.free_mask &= slab.free_mask - 1;
+    if (slab.free_mask == 0) partial_remove(slab_index);
+
+    int id = take_id();
+    slab.slot_id[slot] = id;
+    small_objects[id] = SmallObject{slab_index, slot, size};
+    last_alloc_offset = slab.start + slot * slab.obj_size;
+    small_allocs++;
+    return id;
+}
+
+static void release_slot(uint32_t slab_index, uint32_t slot) {
+    Slab& slab = slabs[slab_index];
+    recycle_id(slab.slot_id[slot]);
+    bool was_full = slab.free_mask == 0;
+    slab.free_mask |= 1ULL << slot;
+
+    uint64_t all = slab.capacity == 64 ? ~0ULL : ((1ULL << slab.capacity) - 1);
+    if (slab.free_mask == all) {
+        // empty slab goes straight back to the coalescing heap
+        if (!was_full) partial_remove(slab_index);
+        int index = find_block_at(slab.start);
+        if (index != -1) release_block(index);
+        slab.live = false;
+        slab_at.erase(slab.start);
+        spare_slabs.push_back(slab_index);
+    } else if (was_full) {
+        partial_push(slab_index);
+    }
+}
+
+bool free_small(int id, size_t size) {
+    auto it = small_objects.find(id);
+    if (it == small_objects.end()) return false;
+    if (size > slabs[it->second.slab].obj_size) return false;
+    uint32_t slab_index = it->second.slab;
+    uint32_t slot = it->second.slot;
+    small_objects.erase(it);
+    release_slot(slab_index, slot);
+    return true;
+}
+
+// Slab index and slot of the live object at `offset`; false if there is none.
+static bool object_at(size_t slab_start, size_t offset, uint32_t& slab_index, uint32_t& slot) {
+    auto found = slab_at.find(slab_start);
+    if (found == slab_at.end()) return false;
+    slab_index = found->second;
+    const Slab& slab = slabs[slab_index];
+
+    size_t rel = offset - slab.start;
+    if (rel % slab.obj_size != 0) return false;
+    slot = rel / slab.obj_size;
+    return slot < slab.capacity && !((slab.free_mask >> slot) & 1);
+}
+
+int small_id_at(size_t slab_start, size_t offset) {
+    uint32_t slab_index, slot;
+    if (!object_at(slab_start, offset, slab_index, slot)) return 0;
+    return slabs[slab_index].slot_id[slot];
+}
+
+bool free_small_at(size_t slab_start, size_t offset, size_t size) {
+    uint32_t slab_index, slot;
+    if (!object_at(slab_start, offset, slab_index, slot)) return false;
+    if (size > slabs[slab_index].obj_size) return false;
+
+    small_objects.erase(slabs[slab_index].slot_id[slot]);
+    release_slot(slab_index, slot);
+    return true;
+}
+
+HybridStats get_hybrid_stats() {
+    HybridStats stats{};
+    for (const auto& slab : slabs) {
+        if (!slab.live) continue;
+        stats.slabs++;
+        stats.slab_bytes += slab.obj_size * slab.capacity;
+        stats.free_slots += __builtin_popcountll(slab.free_mask);
+    }
+    for (const auto& entry : small_objects) {
+        stats.live_objects++;
+        stats.requested_bytes += entry.second.requested;
+        stats.class_bytes += slabs[entry.second.slab].obj_size;
+    }
+    for (const auto& block : memory) {
+        if (block.used && block.id != SLAB_BLOCK_ID) {
+            stats.large_blocks++;
+            stats.large_bytes += block.size;
+        }
+    }
+    stats.small_allocs = small_allocs;
+    stats.large_allocs = large_allocs;
+    return stats;
+}
+
+void show_hybrid_stats() {
+    HybridStats stats = get_hybrid_stats();
+    double internal = stats.class_bytes > 0
+        ? 1.0 - (double)stats.requested_bytes / stats.class_bytes : 0.0;
+
+    const vector<size_t>& sizes = get_size_classes();
+    cout << "\n[Hybrid Small Path] (threshold " << (sizes.empty() ? 0 : sizes.back())
+         << " bytes, " << sizes.size() << " classes)\n";
+    cout << "Slabs                 : " << stats.slabs << " (" << stats.slab_bytes << " bytes)\n";
+    cout << "Live Objects          : " << stats.live_objects << "\n";
+    cout << "Free Slots            : " << stats.free_slots << "\n";
+    cout << "Internal Fragmentation: " << internal * 100 << "%\n";
+    cout << "Allocations           : " << stats.small_allocs << "\n";
+
+    cout << "\n[Hybrid Large Path]\n";
+    cout << "Used Blocks           : " << stats.large_blocks << " (" << stats.large_bytes << " bytes)\n";
+    cout << "Allocations           : " << stats.large_allocs << "\n";
+}
@@ -0,0 +1,100 @@
+#include "heap_internal.hpp"
+#include <iostream>
+
+using namespace std;
+
+static LocalityStats totals;
+static size_t near_gap_sum = 0;
+static size_t plain_gap_sum = 0;
+
+void reset_locality() {
+    totals = LocalityStats{};
+    near_gap_sum = 0;
+    plain_gap_sum = 0;
+}
+
+// Bytes between two non-overlapping ranges.
+static size_t gap_between(size_t a, size_t a_size, size_t b, size_t b_size) {
+    return a < b ? b - (a + a_size) : a - (b + b_size);
+}
+
+static int find_neighbour(int id) {
+    if (id <= 0) return -1;
+    for (size_t i = 0; i < memory.size(); ++i)
+        if (memory[i].used && memory[i].id == id) return i;
+    return -1;
+}
+
+int allocate_near(size_t size, int neighbour_id) {
+    bool fit = current_strategy == FirstFit || current_strategy == BestFit ||
+               current_strategy == WorstFit;
+    size_t rounded = round_to_granule(size);
+    int n = fit && rounded > 0 && !is_huge_request(rounded) ? find_neighbour(neighbour_id) : -1;
+    totals.hinted++;
+    if (n == -1 || ids_exhausted()) {
+        totals.fallbacks++;
+        return allocate(size);
+    }
+    size = rounded;
+    const Block nb = memory[n];
+
+    // walk outward from the neighbour along the address-ordered block list,
+    // always stepping to whichever side is currently closer
+    size_t lo = n, hi = n + 1;
+    size_t below_gap = 0, above_gap = 0;   // free bytes already passed on each side
+    int pick = -1;
+    while (lo > 0 || hi < memory.size()) {
+        bool go_low = lo > 0 && (hi >= memory.size() || below_gap <= above_gap);
+        size_t i = go_low ? --lo : hi++;
+        const Block& b = memory[i];
+        if (!b.used && b.size >= size) {
+            pick = i;
+            break;
+        }
+        (go_low ? below_gap : above_gap) += b.size;
+    }
+    if (pick == -1) {
+        totals.fallbacks++;
+        return allocate(size);
+    }
+
+    uint64_t t0 = tracing ? trace_now() : 0;
+    residency_tick();
+    profile_request(size);
+
+    // where the plain strategy would have put it, for the comparison in stats
+    int plain = find_fit(size, current_strategy);
+    if (plain != -1)
+        plain_gap_sum += gap_between(memory[plain].start, size, nb.start, nb.size);
+
+    // carve from the side facing the neighbour
+    size_t index = pick;
+    if (memory[index].start < nb.start && memory[index].size > size) {
+        split_free_block(index, memory[index].size - size);
+        index++;
+    }
+    int id = take_id();
+    place_block(index, size, id);
+    if (tracing) {
+        trace_record(TraceAllocate, t0, id, size, memory[index].start);
+        trace_heap();
+    }
+
+    near_gap_sum += gap_between(memory[index].start, size, nb.start, nb.size);
+    totals.placed_near++;
+    totals.avg_gap = (double)near_gap_sum / totals.placed_near;
+    totals.avg_plain_gap = (double)plain_gap_sum / totals.placed_near;
+    return id;
+}
+
+LocalityStats get_locality_stats() {
+    return totals;
+}
+
+void show_locality_stats() {
+    if (totals.hinted == 0) return;
+    cout << "\n[Co-allocation Hints] (" << totals.hinted << " hinted, "
+         << totals.fallbacks << " fell back)\n";
+    cout << "Avg Gap to Neighbour  : " << totals.avg_gap << " bytes ("
+         << totals.avg_plain_gap << " bytes unhinted)\n";
+}
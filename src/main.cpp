@@ -2,59 +2,422 @@
 #include <iostream>
 #include <vector>
 #include <iomanip>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
 #include "allocator.hpp"
+#include "batch.hpp"
+#include "block_tree.hpp"
+#include "cache_sim.hpp"
+#include "server.hpp"
+#include "snapshot.hpp"
+#include "tagged_heap.hpp"
 using namespace std;
 
-int main() {
+const size_t MAX_ARGS = 8;
+
+// The boundary-tag heap keeps its own buffer beside the simulated heap.
+static TaggedHeap tagged(MEMORY_SIZE);
+
+// Executes one tokenized command line; returns false on `exit`.
+static bool run_command(const string_view* args, size_t argc) {
+    if (argc == 0) return true;
+    string_view command = args[0];
+
+    if (command == "alloc") {
+        // alloc <size> [short|long]
+        size_t sz;
+        LifetimeHint hint = LifetimeUnknown;
+        if (argc > 2 && args[2] == "short") hint = ShortLived;
+        else if (argc > 2 && args[2] == "long") hint = LongLived;
+        if (argc < 2 || !parse_size(args[1], sz) || (argc > 2 && hint == LifetimeUnknown)) {
+            cout << "Usage: alloc <size> [short|long]\n";
+            return true;
+        }
+        int id = allocate(sz, hint);
+        if (id == -1)
+            cout << "Allocation failed\n";
+        else
+            cout << "Allocated ID: " << id << "\n";
+    } else if (command == "near") {
+        // near <size> <id>
+        size_t sz;
+        int neighbour;
+        if (argc < 3 || !parse_size(args[1], sz) || !parse_int(args[2], neighbour)) {
+            cout << "Usage: near <size> <id>\n";
+            return true;
+        }
+        int id = allocate_near(sz, neighbour);
+        if (id == -1)
+            cout << "Allocation failed\n";
+        else
+            cout << "Allocated ID: " << id << "\n";
+    } else if (command == "free") {
+        // free <id> [size]
+        int id;
+        size_t size = 0;
+        if (argc < 2 || !parse_int(args[1], id) || (argc > 2 && !parse_size(args[2], size))) {
+            cout << "Usage: free <id> [size]\n";
+            return true;
+        }
+        if (argc > 2 ? free_block(id, size) : free_block(id))
+            cout << "Freed ID: " << id << "\n";
+        else
+            cout << "Free failed\n";
+    } else if (command == "mark") {
+        size_t marker = push_marker();
+        if (marker == SIZE_MAX) cout << "Markers need the stack strategy\n";
+        else cout << "Marker: " << marker << "\n";
+    } else if (command == "release") {
+        size_t marker;
+        if (argc < 2 || !parse_size(args[1], marker)) {
+            cout << "Usage: release <marker>\n";
+            return true;
+        }
+        cout << (pop_to_marker(marker) ? "Released to marker " : "Cannot release to marker ")
+             << marker << "\n";
+    } else if (command == "halloc") {
+        size_t sz;
+        if (argc < 2 || !parse_size(args[1], sz)) {
+            cout << "Usage: halloc <size>\n";
+            return true;
+        }
+        Handle h = allocate_handle(sz);
+        if (h == NULL_HANDLE)
+            cout << "Allocation failed\n";
+        else
+            cout << "Allocated handle: " << h << " (ID: " << handle_id(h) << ")\n";
+    } else if (command == "hfree") {
+        uint64_t h;
+        if (argc < 2 || !parse_u64(args[1], h)) {
+            cout << "Usage: hfree <handle>\n";
+            return true;
+        }
+        if (free_handle(h))
+            cout << "Freed handle: " << h << "\n";
+        else
+            cout << "Stale or invalid handle\n";
+    } else if (command == "arena") {
+        // arena new <bytes> | arena <alloc> <a> <size> | arena <push|pop|reset|free> <a>
+        string_view sub = argc > 1 ? args[1] : "";
+        size_t n = 0;
+        int a = 0;
+        bool ok = argc > 2 && (sub == "new" ? parse_size(args[2], n) : parse_int(args[2], a));
+        if (ok && sub == "new") {
+            int created = arena_create(n);
+            if (created == -1) cout << "Arena creation failed\n";
+            else cout << "Created arena: " << created << "\n";
+        } else if (ok && sub == "alloc" && argc > 3 && parse_size(args[3], n)) {
+            size_t at = arena_alloc(a, n);
+            if (at == SIZE_MAX) cout << "Arena allocation failed\n";
+            else cout << "Arena " << a << " offset: " << at << "\n";
+        } else if (ok && (sub == "push" || sub == "pop" || sub == "reset" || sub == "free")) {
+            bool done = sub == "push" ? arena_push_scope(a)
+                      : sub == "pop"  ? arena_pop_scope(a)
+                      : sub == "reset" ? arena_reset(a)
+                      : arena_destroy(a);
+            cout << (done ? "OK\n" : "Arena operation failed\n");
+        } else {
+            cout << "Usage: arena new <bytes> | arena alloc <arena> <size> | arena <push|pop|reset|free> <arena>\n";
+        }
+    } else if (command == "tagged") {
+        // tagged new <bytes> | tagged alloc <size> | tagged free <offset> | tagged show
+        string_view sub = argc > 1 ? args[1] : "";
+        size_t n = 0;
+        bool ok = argc > 2 && parse_size(args[2], n);
+        if (ok && sub == "new") {
+            tagged.reset(n);
+            cout << "Tagged heap: " << tagged.capacity() << " bytes\n";
+        } else if (ok && sub == "alloc") {
+            size_t at = tagged.allocate(n);
+            if (at == TAG_NULL) cout << "Tagged allocation failed\n";
+            else cout << "Tagged offset: " << at << " (block " << tagged.block_size(at) << " bytes)\n";
+        } else if (ok && sub == "free") {
+            cout << (tagged.free(n) ? "Freed tagged offset: " : "Tagged free failed: ") << n << "\n";
+        } else if (sub == "show") {
+            TagStats s = tagged.stats();
+            cout << "[Tagged Heap] capacity=" << tagged.capacity()
+                 << " used_blocks=" << s.used_blocks
+                 << " total_free=" << s.total_free
+                 << " largest_free=" << s.largest_free
+                 << " fragments=" << s.fragments
+                 << " tag_bytes=" << s.tag_bytes
+                 << " consistent=" << (tagged.check() ? "yes" : "no") << "\n";
+        } else {
+            cout << "Usage: tagged new <bytes> | tagged alloc <size> | tagged free <offset> | tagged show\n";
+        }
+    } else if (command == "freeat") {
+        // freeat <offset> [size]
+        size_t offset, size = 0;
+        if (argc < 2 || !parse_size(args[1], offset) || (argc > 2 && !parse_size(args[2], size))) {
+            cout << "Usage: freeat <offset> [size]\n";
+            return true;
+        }
+        if (free_at(offset, size))
+            cout << "Freed offset: " << offset << "\n";
+        else
+            cout << "Free failed\n";
+    } else if (command == "strategy") {
+        string_view strat = argc > 1 ? args[1] : "";
+        bool ok = true;
+        if (strat == "first")
+            ok = set_strategy(FirstFit);
+        else if (strat == "best")
+            ok = set_strategy(BestFit);
+        else if (strat == "worst")
+            ok = set_strategy(WorstFit);
+        else if (strat == "buddy")
+            ok = set_strategy(Buddy);
+        else if (strat == "hybrid")
+            ok = set_strategy(Hybrid);
+        else if (strat == "bitmap")
+            ok = set_strategy(Bitmap);
+        else if (strat == "stack")
+            ok = set_strategy(Stack);
+        else
+            cout << "Unknown strategy\n";
+        if (!ok) cout << "Buddy needs a power-of-two heap; turn the huge region off first\n";
+    } else if (command == "granule") {
+        size_t bytes;
+        if (argc < 2 || !parse_size(args[1], bytes) || !set_granule(bytes))
+            cout << "Usage: granule <power of two up to " << SIM_PAGE_SIZE << ">\n";
+        else
+            cout << "Granule set to " << bytes << " bytes\n";
+    } else if (command == "threshold") {
+        size_t bytes;
+        if (argc < 2 || !parse_size(args[1], bytes)) {
+            cout << "Usage: threshold <bytes>\n";
+            return true;
+        }
+        if (bytes > max_small_threshold())
+            cout << "Threshold must be at most " << max_small_threshold() << " bytes (half the heap)\n";
+        else if (set_small_threshold(bytes))
+            cout << "Small-object threshold: " << bytes << " bytes\n";
+        else
+            cout << "Cannot change size classes while small objects are live\n";
+    } else if (command == "profile") {
+        string_view mode = argc > 1 ? args[1] : "";
+        if (mode == "on" || mode == "off") {
+            set_size_profiling(mode == "on");
+            cout << "Size profiling " << mode << "\n";
+        } else if (mode == "clear") {
+            clear_size_profile();
+        } else {
+            cout << "Usage: profile <on|off|clear>\n";
+        }
+    } else if (command == "classes") {
+        // classes [budget] [max_size]: show, or derive from the profile
+        size_t budget = 0, max_size = 0;
+        if ((argc > 1 && !parse_size(args[1], budget)) || (argc > 2 && !parse_size(args[2], max_size))) {
+            cout << "Usage: classes [budget] [max_size]\n";
+            return true;
+        }
+        const vector<size_t>& current = get_size_classes();
+        if (budget > 0) {
+            if (max_size == 0) max_size = current.empty() ? 64 : current.back();
+            vector<size_t> derived = derive_size_classes(budget, max_size);
+            if (derived.empty()) {
+                cout << "No profiled requests up to " << max_size << " bytes\n";
+                return true;
+            }
+            cout << "Derived classes:";
+            for (size_t c : derived) cout << " " << c;
+            cout << "\nRounding waste: " << size_class_waste(derived) << " bytes (current classes: "
+                 << size_class_waste(current) << ") over " << profiled_requests() << " requests\n"
+                 << "Loaded by the next reset\n";
+            set_startup_size_classes(derived);
+        } else {
+            cout << "Size classes:";
+            for (size_t c : current) cout << " " << c;
+            cout << "\n";
+        }
+    } else if (command == "reset") {
+        initialize_memory();
+        cout << "Heap reset\n";
+    } else if (command == "huge") {
+        // huge <threshold> <region_bytes> | huge off
+        size_t threshold = 0, bytes = 0;
+        bool off = argc > 1 && args[1] == "off";
+        if (!off && (argc < 3 || !parse_size(args[1], threshold) || !parse_size(args[2], bytes))) {
+            cout << "Usage: huge <threshold> <region_bytes> | huge off\n";
+            return true;
+        }
+        if (!set_huge_region(threshold, bytes))
+            cout << "Cannot reconfigure huge region (live spans, top of heap in use, or Buddy strategy)\n";
+        else if (off)
+            cout << "Huge region disabled\n";
+        else
+            cout << "Huge region: " << get_huge_stats().region_bytes << " bytes for requests >= "
+                 << threshold << "\n";
+    } else if (command == "purge") {
+        // purge [none|immediate|decay <ops>|now]
+        string_view mode = argc > 1 ? args[1] : "now";
+        size_t decay = 100;
+        if (mode == "now") {
+            cout << "Purged " << purge_free_pages() << " pages\n";
+        } else if (mode == "none") {
+            set_purge_policy(PurgeNone);
+        } else if (mode == "immediate") {
+            set_purge_policy(PurgeImmediate);
+        } else if (mode == "decay" && (argc < 3 || parse_size(args[2], decay))) {
+            set_purge_policy(PurgeDecay, decay);
+        } else {
+            cout << "Usage: purge [now|none|immediate|decay <ops>]\n";
+        }
+    } else if (command == "backing") {
+        string_view mode = argc > 1 ? args[1] : "";
+        if ((mode == "on" || mode == "off") && set_real_backing(mode == "on"))
+            cout << "Real backing " << mode << "\n";
+        else
+            cout << "Usage: backing <on|off>\n";
+    } else if (command == "grow") {
+        // grow <chunk> [max_heap] [trim_at]; grow 0 keeps the heap fixed
+        size_t chunk, max_heap = 0, trim_at = 0;
+        if (argc < 2 || !parse_size(args[1], chunk) ||
+            (argc > 2 && !parse_size(args[2], max_heap)) ||
+            (argc > 3 && !parse_size(args[3], trim_at))) {
+            cout << "Usage: grow <chunk> [max_heap] [trim_at]\n";
+            return true;
+        }
+        set_heap_growth(chunk, max_heap, trim_at);
+    } else if (command == "trim") {
+        cout << "Trimmed " << trim_heap() << " bytes\n";
+    } else if (command == "save") {
+        string path(argc > 1 ? args[1] : "");
+        if (!path.empty() && save_heap(path))
+            cout << "Heap saved to " << path << "\n";
+        else
+            cout << "Save failed\n";
+    } else if (command == "load") {
+        string path(argc > 1 ? args[1] : "");
+        if (!path.empty() && load_heap(path))
+            cout << "Heap loaded from " << path << "\n";
+        else
+            cout << "Load failed\n";
+    } else if (command == "show") {
+        size_t from, to;
+        if (argc > 2 && parse_size(args[1], from) && parse_size(args[2], to))
+            show_memory(from, to);
+        else
+            show_memory();
+    } else if (command == "indexbench") {
+        // indexbench <blocks> [ops]
+        size_t blocks, ops = 100000;
+        if (argc < 2 || !parse_size(args[1], blocks) || blocks == 0 ||
+            (argc > 2 && !parse_size(args[2], ops))) {
+            cout << "Usage: indexbench <blocks> [ops]\n";
+            return true;
+        }
+        run_block_index_benchmark(blocks, ops);
+    } else if (command == "exit") {
+        return false;
+    } else if (command == "help") {
+        cout << "Commands:\n  alloc <size> [short|long]\n                - Allocate memory (long-lived: placed from the top)\n  near <size> <id> - Allocate as close as possible to block <id>\n  free <id> [size] - Free block by ID (sized: skips other paths)\n  freeat <offset> [size]\n                - Free the allocation starting at offset\n  arena new <bytes> | arena alloc <a> <size> | arena <push|pop|reset|free> <a>\n                - Bump-allocating regions with scopes and O(1) reset\n  mark / release <marker>\n                - Stack strategy: save the top / free everything above it\n  halloc <size> / hfree <handle>\n                - Allocate / free through a generation-tagged handle\n  tagged new <bytes> | tagged alloc <size> | tagged free <offset> | tagged show\n                - Separate heap with in-band boundary tags\n  show [from to] - Show memory layout (optionally an address range)\n  strategy <first|best|worst|buddy|hybrid|bitmap|stack>\n                - Switch allocation strategy\n  threshold <n> - Hybrid small-object threshold in bytes\n  granule <n>   - Round requests to n-byte granules (compact metadata)\n  profile <on|off|clear> - Record request sizes\n  classes [budget] [max] - Show size classes / derive them from the profile\n  reset         - Reinitialize the heap (loads derived classes)\n  huge <threshold> <bytes> | huge off\n                - Dedicated page-span region for huge requests\n  purge [now|none|immediate|decay <ops>]\n                - Release free pages / set the purge policy\n  backing <on|off> - Mirror the heap with real mmap'd memory\n  grow <chunk> [max] [trim_at]\n                - Grow the heap on allocation failure\n  trim          - Return a free heap tail to the OS\n  save <path>   - Snapshot heap state to a file\n  load <path>   - Restore heap state from a snapshot\n  benchmark [random|ramp|fifo|lifo|mixed] [uniform|bimodal|powerlaw] [ops] [seed]\n                - Benchmark all strategies on a workload\n  trace <path> | trace off\n                - Write a Chrome/Perfetto trace of heap operations\n  cachesim off | cachesim <recent|random> [line] [l1] [l2]\n                - Score benchmark placement with an L1/L2 cache model\n  indexbench <blocks> [ops]\n                - Time vector vs B+tree block index churn\n  exit          - Quit\n";
+    } else if (command == "frag" || command == "stats") {
+        show_fragmentation_stats();
+    } else if (command == "visual") {
+        show_memory_ascii();
+    } else if (command == "trace") {
+        // trace <path> | trace off
+        if (argc == 2 && args[1] == "off") {
+            TraceStats s = get_trace_stats();
+            size_t written = trace_stop();
+            cout << "Trace closed: " << written << " events written, "
+                 << s.dropped << " dropped\n";
+        } else if (argc == 2 && trace_start(string(args[1]).c_str())) {
+            cout << "Tracing to " << args[1] << "\n";
+        } else {
+            cout << "Usage: trace <path> | trace off (one trace at a time)\n";
+        }
+    } else if (command == "cachesim") {
+        // cachesim off | cachesim <recent|random> [line] [l1_bytes] [l2_bytes]
+        CacheSimConfig config;
+        bool ok = argc > 1 && (args[1] == "recent" || args[1] == "random");
+        if (argc == 2 && args[1] == "off") {
+            disable_cache_simulation();
+            cout << "Cache simulation off\n";
+            return true;
+        }
+        if (ok && args[1] == "random") config.pattern = RandomLive;
+        if (ok && argc > 2) ok = parse_size(args[2], config.line);
+        if (ok && argc > 3) ok = parse_size(args[3], config.l1_size);
+        if (ok && argc > 4) ok = parse_size(args[4], config.l2_size);
+        if (!ok || !set_cache_simulation(config)) {
+            cout << "Usage: cachesim off | cachesim <recent|random> [line] [l1_bytes] [l2_bytes]\n"
+                    "       (line a power of two; each level at least one set)\n";
+            return true;
+        }
+        cout << "Cache simulation on: " << config.line << "-byte lines, L1 "
+             << config.l1_size << " B " << config.l1_ways << "-way, L2 "
+             << config.l2_size << " B " << config.l2_ways << "-way\n";
+    } else if (command == "benchmark") {
+        // benchmark [pattern] [sizes] [ops] [seed]
+        WorkloadConfig config;
+        if (argc > 1 && !parse_workload_pattern(string(args[1]), config.pattern)) {
+            cout << "Unknown workload pattern\n";
+            return true;
+        }
+        if (argc > 2 && !parse_size_distribution(string(args[2]), config.sizes)) {
+            cout << "Unknown size distribution\n";
+            return true;
+        }
+        if ((argc > 3 && (!parse_int(args[3], config.ops) || config.ops <= 0)) ||
+            (argc > 4 && !parse_u64(args[4], config.seed))) {
+            cout << "Usage: benchmark [pattern] [sizes] [ops > 0] [seed]\n";
+            return true;
+        }
+        run_benchmarks(config);
+    } else {
+        cout << "Unknown command\n";
+    }
+    return true;
+}
+
+// Non-interactive mode: no prompts, chunked input, fully buffered output.
+static int run_batch(const char* path) {
+    int fd = STDIN_FILENO;
+    if (path && strcmp(path, "-") != 0) {
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            cerr << "Cannot open script: " << path << "\n";
+            return 1;
+        }
+    }
+
+    static char out_buf[1 << 20];
+    setvbuf(stdout, out_buf, _IOFBF, sizeof(out_buf));
+
+    LineReader reader(fd);
+    string_view line;
+    string_view args[MAX_ARGS];
+    while (reader.next_line(line)) {
+        size_t argc = split_tokens(line, args, MAX_ARGS);
+        if (argc > 0 && args[0][0] == '#') continue;   // comment line
+        if (!run_command(args, argc)) break;
+    }
+
+    cout.flush();
+    if (fd != STDIN_FILENO) close(fd);
+    return 0;
+}
+
+int main(int argc, char** argv) {
     initialize_memory();
-    string command;
+
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0)
+        return run_batch(argc > 2 ? argv[2] : nullptr);
+    if (argc > 2 && strcmp(argv[1], "--serve") == 0)
+        return run_server(argv[2]);
+
     cout << "Mini Runtime Allocator (type 'help' for commands)\n";
+    string line;
+    string_view args[MAX_ARGS];
     while (true) {
-        cout << "> ";
-        cin >> command;
-        if (command == "alloc") {
-            size_t sz;
-            cin >> sz;
-            int id = allocate(sz);
-            if (id == -1)
-                cout << "Allocation failed\n";
-            else
-                cout << "Allocated ID: " << id << "\n";
-        } else if (command == "free") {
-            int id;
-            cin >> id;
-            if (free_block(id))
-                cout << "Freed ID: " << id << "\n";
-            else
-                cout << "Free failed\n";
-        } else if (command == "strategy") {
-            string strat;
-            cin >> strat;
-            if (strat == "first")
-                set_strategy(FirstFit);
-            else if (strat == "best")
-                set_strategy(BestFit);
-            else if (strat == "worst")
-                set_strategy(WorstFit);
-            else if (strat == "buddy")
-                set_strategy(Buddy);
-            else
-                cout << "Unknown strategy\n";
-        }else if (command == "show") {
-            show_memory();
-        } else if (command == "exit") {
-            break;
-        } else if (command == "help") {
-            cout << "Commands:\n  alloc <size>  - Allocate memory\n  free <id>     - Free block by ID\n  show          - Show memory layout\n  exit          - Quit\n";
-        } else if (command == "frag" || command == "stats") {
-            show_fragmentation_stats();
-        }else if (command == "visual") {
-            show_memory_ascii();
-        }else if (command == "benchmark") {
-            run_benchmarks(1000, 200);
-        }else {
-            cout << "Unknown command\n";
-        }
+        cout << "> " << flush;
+        if (!getline(cin, line)) break;
+        size_t count = split_tokens(line, args, MAX_ARGS);
+        if (!run_command(args, count)) break;
     }
     return 0;
 }
@@ -0,0 +1,156 @@
+#include "heap_internal.hpp"
+#include <iostream>
+#include <unordered_map>
+
+using namespace std;
+
+struct CachedObject {
+    size_t offset;
+    int id;
+};
+
+struct ObjectCache {
+    size_t obj_size;
+    ObjectCtor ctor;
+    ObjectDtor dtor;
+    void* arg;
+    size_t depth;
+    vector<CachedObject> free_objects;       // constructed, LIFO for cache warmth
+    unordered_map<size_t, int> live;         // offset -> allocation id
+    size_t hits;
+    size_t misses;
+    size_t constructed;
+    size_t destroyed;
+    size_t reclaimed;
+};
+
+static vector<ObjectCache> caches;   // cache id - 1
+static bool hook_registered = false;
+
+static ObjectCache* find_cache(int cache) {
+    if (cache <= 0 || (size_t)cache > caches.size()) return nullptr;
+    return &caches[cache - 1];
+}
+
+static void destroy_object(ObjectCache& c, const CachedObject& obj) {
+    if (c.dtor && heap_base()) c.dtor(heap_base() + obj.offset, c.arg);
+    c.destroyed++;
+    // the heap may have been reset under the cache; only free what is ours
+    if (id_at(obj.offset) == obj.id) free_at(obj.offset);
+}
+
+static size_t drain(ObjectCache& c, size_t keep) {
+    size_t bytes = 0;
+    while (c.free_objects.size() > keep) {
+        destroy_object(c, c.free_objects.back());
+        c.free_objects.pop_back();
+        c.reclaimed++;
+        bytes += c.obj_size;
+    }
+    return bytes;
+}
+
+static size_t reclaim_all() {
+    return cache_reclaim(0);
+}
+
+void reset_caches() {
+    // the objects went with the heap; types and settings survive
+    for (auto& c : caches) {
+        c.free_objects.clear();
+        c.live.clear();
+    }
+}
+
+int cache_create(size_t obj_size, ObjectCtor ctor, ObjectDtor dtor, void* arg, size_t depth) {
+    if (obj_size == 0 || !heap_base()) return -1;
+    if (!hook_registered) {
+        add_reclaim_hook(reclaim_all);
+        hook_registered = true;
+    }
+    caches.push_back(ObjectCache{obj_size, ctor, dtor, arg, depth, {}, {}, 0, 0, 0, 0, 0});
+    return caches.size();
+}
+
+bool cache_set_depth(int cache, size_t depth) {
+    ObjectCache* c = find_cache(cache);
+    if (!c) return false;
+    c->depth = depth;
+    drain(*c, depth);
+    return true;
+}
+
+size_t cache_alloc(int cache) {
+    ObjectCache* c = find_cache(cache);
+    if (!c || !heap_base()) return SIZE_MAX;
+
+    if (!c->free_objects.empty()) {
+        CachedObject obj = c->free_objects.back();
+        c->free_objects.pop_back();
+        c->live[obj.offset] = obj.id;
+        c->hits++;
+        return obj.offset;
+    }
+
+    size_t offset;
+    int id = allocate(c->obj_size, offset);
+    // allocate() may have reclaimed from this very cache; c is still valid
+    if (id == -1) return SIZE_MAX;
+    if (c->ctor) c->ctor(heap_base() + offset, c->arg);
+    c->constructed++;
+    c->misses++;
+    c->live[offset] = id;
+    return offset;
+}
+
+bool cache_free(int cache, size_t offset) {
+    ObjectCache* c = find_cache(cache);
+    if (!c) return false;
+    auto it = c->live.find(offset);
+    if (it == c->live.end()) return false;
+
+    CachedObject obj{offset, it->second};
+    c->live.erase(it);
+    if (c->free_objects.size() < c->depth)
+        c->free_objects.push_back(obj);   // stays constructed
+    else
+        destroy_object(*c, obj);
+    return true;
+}
+
+size_t cache_reclaim(int cache) {
+    if (cache != 0) {
+        ObjectCache* c = find_cache(cache);
+        return c ? drain(*c, 0) : 0;
+    }
+    size_t bytes = 0;
+    for (auto& c : caches) bytes += drain(c, 0);
+    return bytes;
+}
+
+CacheStats get_cache_stats(int cache) {
+    CacheStats stats{};
+    ObjectCache* c = find_cache(cache);
+    if (!c) return stats;
+    stats.obj_size = c->obj_size;
+    stats.depth = c->depth;
+    stats.cached = c->free_objects.size();
+    stats.live = c->live.size();
+    stats.hits = c->hits;
+    stats.misses = c->misses;
+    stats.constructed = c->constructed;
+    stats.destroyed = c->destroyed;
+    stats.reclaimed = c->reclaimed;
+    return stats;
+}
+
+void show_cache_stats() {
+    if (caches.empty()) return;
+    cout << "\n[Object Caches]\n";
+    for (size_t i = 0; i < caches.size(); ++i) {
+        CacheStats s = get_cache_stats(i + 1);
+        cout << "Cache " << i + 1 << " (" << s.obj_size << " bytes, depth " << s.depth << "): "
+             << s.live << " live, " << s.cached << " cached, " << s.hits << " hits / "
+             << s.misses << " misses, " << s.reclaimed << " reclaimed\n";
+    }
+}
@@ -0,0 +1,85 @@
+#include "perf_counters.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+
+static int open_counter(uint64_t config, int group) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group == -1;   // the group starts and stops with its leader
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+PerfCounters::PerfCounters() {
+    leader = open_counter(PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (leader == -1) return;
+    const uint64_t configs[3] = {PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                 PERF_COUNT_HW_BRANCH_MISSES};
+    for (int i = 0; i < 3; ++i) {
+        members[i] = open_counter(configs[i], leader);
+        if (members[i] == -1) {
+            // all or nothing: a partial group would make the ratios lie
+            for (int j = 0; j < i; ++j) close(members[j]);
+            close(leader);
+            leader = -1;
+            for (int& fd : members) fd = -1;
+            return;
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : members)
+        if (fd != -1) close(fd);
+    if (leader != -1) close(leader);
+}
+
+void PerfCounters::start() {
+    if (leader == -1) return;
+    ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void PerfCounters::pause() {
+    if (leader != -1) ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void PerfCounters::resume() {
+    if (leader != -1) ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+PerfSample PerfCounters::stop() {
+    PerfSample sample{};
+    if (leader == -1) return sample;
+    ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+    uint64_t buf[5];   // nr, then one value per counter in open order
+    if (read(leader, buf, sizeof(buf)) != (ssize_t)sizeof(buf) || buf[0] != 4) return sample;
+    sample.valid = true;
+    sample.cycles = buf[1];
+    sample.instructions = buf[2];
+    sample.cache_misses = buf[3];
+    sample.branch_misses = buf[4];
+    return sample;
+}
+
+#else
+
+PerfCounters::PerfCounters() {}
+PerfCounters::~PerfCounters() {}
+void PerfCounters::start() {}
+void PerfCounters::pause() {}
+void PerfCounters::resume() {}
+PerfSample PerfCounters::stop() { return PerfSample{}; }
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstdint>
+
+// Hardware counters for one benchmark phase: cycles, instructions, cache
+// misses and branch misses of this thread in user space, read as one
+// perf_event_open group so all four cover the same interval. Where the
+// kernel refuses (no PMU in a VM or container, perf_event_paranoid too high)
+// or the platform is not Linux, available() is false and the benchmark falls
+// back to timing only.
+struct PerfSample {
+    bool valid;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t cache_misses;
+    uint64_t branch_misses;
+};
+
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const { return leader != -1; }
+    void start();
+    // Exclude a stretch between start() and stop(), such as logging, from
+    // the counts without resetting them.
+    void pause();
+    void resume();
+    // Counts since start(); valid is false when the counters are unavailable.
+    PerfSample stop();
+
+private:
+    int leader = -1;
+    int members[3] = {-1, -1, -1};
+};
@@ -0,0 +1,195 @@
+#include "heap_internal.hpp"
+#include <deque>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+static vector<PageState> pages;
+static vector<uint32_t> page_refs;     // used ranges overlapping each page
+static vector<uint64_t> dirty_since;   // tick at which the page went dirty
+static deque<pair<size_t, uint64_t>> dirty_queue;   // (page, tick), oldest first
+static uint64_t now = 0;
+static size_t purged_total = 0;
+
+static PurgePolicy purge_policy = PurgeNone;
+static uint64_t decay_ops = 100;
+
+static char* backing = nullptr;
+static size_t backing_bytes = 0;
+
+static size_t os_page_size() {
+    static size_t size = sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+static size_t round_to_os_page(size_t bytes) {
+    return (bytes + os_page_size() - 1) / os_page_size() * os_page_size();
+}
+
+void reset_residency() {
+    size_t count = (heap_size + SIM_PAGE_SIZE - 1) / SIM_PAGE_SIZE;
+    pages.assign(count, PageClean);
+    page_refs.assign(count, 0);
+    dirty_since.assign(count, 0);
+    dirty_queue.clear();
+    now = 0;
+    purged_total = 0;
+    if (backing) {
+        resize_residency(heap_size);
+        madvise(backing, backing_bytes, MADV_DONTNEED);
+    }
+}
+
+void resize_residency(size_t bytes) {
+    size_t count = (bytes + SIM_PAGE_SIZE - 1) / SIM_PAGE_SIZE;
+    pages.resize(count, PageClean);
+    page_refs.resize(count, 0);
+    dirty_since.resize(count, 0);
+
+    if (!backing) return;
+    // grow or shrink the mirror with the heap; it may move
+    size_t mapped = round_to_os_page(bytes);
+    if (mapped == backing_bytes) return;
+    void* p = mremap(backing, backing_bytes, mapped, MREMAP_MAYMOVE);
+    if (p == MAP_FAILED) return;
+    backing = static_cast<char*>(p);
+    backing_bytes = mapped;
+}
+
+static void release_os_pages(size_t page) {
+    // the OS page can go only once none of its simulated pages is resident
+    size_t per_os = max<size_t>(1, os_page_size() / SIM_PAGE_SIZE);
+    size_t first = page / per_os * per_os;
+    size_t last = min(first + per_os, pages.size());
+    if (last - first < per_os) return;   // heap tail smaller than an OS page
+    if ((first + per_os) * SIM_PAGE_SIZE > backing_bytes) return;
+    for (size_t p = first; p < last; ++p)
+        if (pages[p] == PageInUse || pages[p] == PageDirty) return;
+    madvise(backing + first * SIM_PAGE_SIZE, per_os * SIM_PAGE_SIZE, MADV_DONTNEED);
+}
+
+static void purge_page(size_t page) {
+    pages[page] = PagePurged;
+    purged_total++;
+    if (backing) release_os_pages(page);
+}
+
+static void decay_dirty_pages() {
+    while (!dirty_queue.empty() && dirty_queue.front().second + decay_ops <= now) {
+        auto [page, tick] = dirty_queue.front();
+        dirty_queue.pop_front();
+        // stale entry if the page was reused, purged or trimmed since it was queued
+        if (page < pages.size() && pages[page] == PageDirty && dirty_since[page] == tick)
+            purge_page(page);
+    }
+}
+
+void residency_tick() {
+    now++;
+    if (purge_policy == PurgeDecay) decay_dirty_pages();
+}
+
+void pages_touch(size_t start, size_t size) {
+    if (size == 0) return;
+    for (size_t p = start / SIM_PAGE_SIZE; p <= (start + size - 1) / SIM_PAGE_SIZE; ++p) {
+        page_refs[p]++;
+        pages[p] = PageInUse;
+    }
+}
+
+void pages_release(size_t start, size_t size) {
+    if (size == 0) return;
+    for (size_t p = start / SIM_PAGE_SIZE; p <= (start + size - 1) / SIM_PAGE_SIZE; ++p) {
+        if (--page_refs[p] > 0) continue;
+        pages[p] = PageDirty;
+        dirty_since[p] = now;
+        // only the decay policy ever drains the queue
+        if (purge_policy == PurgeImmediate) purge_page(p);
+        else if (purge_policy == PurgeDecay) dirty_queue.push_back({p, now});
+    }
+}
+
+void set_purge_policy(PurgePolicy policy, size_t decay) {
+    purge_policy = policy;
+    decay_ops = decay;
+    dirty_queue.clear();
+    if (policy == PurgeImmediate) purge_free_pages();
+    if (policy != PurgeDecay) return;
+    // pages already dirty start decaying now
+    for (size_t p = 0; p < pages.size(); ++p) {
+        if (pages[p] != PageDirty) continue;
+        dirty_since[p] = now;
+        dirty_queue.push_back({p, now});
+    }
+}
+
+size_t purge_free_pages() {
+    size_t purged = 0;
+    for (size_t p = 0; p < pages.size(); ++p) {
+        if (pages[p] == PageDirty) {
+            purge_page(p);
+            purged++;
+        }
+    }
+    dirty_queue.clear();
+    return purged;
+}
+
+PageState page_state(size_t page) {
+    return page < pages.size() ? pages[page] : PagePurged;
+}
+
+bool set_real_backing(bool enabled) {
+    if (enabled == (backing != nullptr)) return true;
+    if (!enabled) {
+        munmap(backing, backing_bytes);
+        backing = nullptr;
+        backing_bytes = 0;
+        return true;
+    }
+
+    size_t bytes = round_to_os_page(heap_size);
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return false;
+    backing = static_cast<char*>(p);
+    backing_bytes = bytes;
+    return true;
+}
+
+char* heap_base() {
+    return backing;
+}
+
+ResidencyStats get_residency_stats() {
+    ResidencyStats stats{};
+    stats.pages = pages.size();
+    for (PageState state : pages) {
+        if (state == PageInUse) stats.in_use++;
+        else if (state == PageDirty) stats.dirty++;
+        else if (state == PageClean) stats.clean++;
+        else stats.purged++;
+    }
+    stats.rss_bytes = (stats.in_use + stats.dirty) * SIM_PAGE_SIZE;
+    stats.purged_total = purged_total;
+
+    if (backing) {
+        // what the kernel actually has resident for the backing mapping
+        size_t os_pages = backing_bytes / os_page_size();
+        vector<unsigned char> vec(os_pages);
+        if (mincore(backing, backing_bytes, vec.data()) == 0)
+            for (unsigned char v : vec)
+                if (v & 1) stats.real_rss_bytes += os_page_size();
+    }
+    return stats;
+}
+
+void show_residency_stats() {
+    ResidencyStats stats = get_residency_stats();
+    cout << "Resident (RSS)        : " << stats.rss_bytes << " bytes ("
+         << stats.in_use << " in use, " << stats.dirty << " dirty, "
+         << stats.clean << " clean, " << stats.purged << " purged pages)\n";
+    if (backing)
+        cout << "Backing RSS (mincore) : " << stats.real_rss_bytes << " bytes\n";
+}
@@ -0,0 +1,276 @@
+#include "server.hpp"
+#include "allocator.hpp"
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const size_t READ_CHUNK = 64 * 1024;
+static const int MAX_EVENTS = 64;
+// Backpressure: a client that sends without reading stops being read once
+// this many reply bytes wait for it, and at most one full request is
+// buffered, so a slow reader costs a few MiB at most.
+static const size_t MAX_PENDING_OUTPUT = 1 << 20;
+static const size_t MAX_PENDING_INPUT = sizeof(uint32_t) + MAX_OPS_PER_MESSAGE * sizeof(WireOp);
+
+static void append_word(vector<char>& out, int64_t word) {
+    const char* p = reinterpret_cast<const char*>(&word);
+    out.insert(out.end(), p, p + sizeof(word));
+}
+
+AllocatorServer::~AllocatorServer() {
+    close();
+}
+
+bool AllocatorServer::listen(const string& path) {
+    close();
+
+    sockaddr_un addr{};
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) return false;
+
+    // replace a stale socket from an earlier run, but never clobber other files
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd, SOMAXCONN) != 0) {
+        close();
+        return false;
+    }
+    socket_path = path;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = listen_fd;
+    if (epoll_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) != 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void AllocatorServer::close() {
+    for (auto& entry : clients) ::close(entry.first);
+    clients.clear();
+    if (epoll_fd >= 0) ::close(epoll_fd);
+    if (listen_fd >= 0) ::close(listen_fd);
+    if (!socket_path.empty()) unlink(socket_path.c_str());
+    epoll_fd = -1;
+    listen_fd = -1;
+    socket_path.clear();
+}
+
+bool AllocatorServer::poll_once(int timeout_ms) {
+    epoll_event events[MAX_EVENTS];
+    int n = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout_ms);
+    if (n < 0) return errno == EINTR;
+
+    for (int i = 0; i < n; ++i) {
+        int fd = events[i].data.fd;
+        if (fd == listen_fd) {
+            accept_clients();
+            continue;
+        }
+        auto it = clients.find(fd);
+        if (it == clients.end()) continue;
+        Client& c = it->second;
+
+        bool alive = true;
+        if (!c.closed && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+            alive = read_client(fd, c);
+        // answer until the socket is full or nothing complete is left
+        while (alive) {
+            process_requests(c);
+            alive = write_client(fd, c);
+            if (c.out_pos < c.out.size() || !has_request(c)) break;
+        }
+        // a half-closed client still gets every reply before it is dropped
+        if (alive && !(c.closed && c.out_pos == c.out.size()))
+            update_interest(fd, c);
+        else
+            drop_client(fd);
+    }
+    return true;
+}
+
+void AllocatorServer::accept_clients() {
+    while (true) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;   // EAGAIN: drained the backlog
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            ::close(fd);
+            continue;
+        }
+        clients[fd].interest = EPOLLIN;
+    }
+}
+
+bool AllocatorServer::read_client(int fd, Client& c) {
+    // stop at one full request; level-triggered epoll reports the rest later
+    while (c.in.size() < MAX_PENDING_INPUT) {
+        size_t old = c.in.size();
+        c.in.resize(old + READ_CHUNK);
+        ssize_t n = read(fd, c.in.data() + old, READ_CHUNK);
+        c.in.resize(old + (n > 0 ? n : 0));
+        if (n > 0) continue;
+        if (n == 0) {
+            // peer finished sending; answer what is buffered, then drop it
+            c.closed = true;
+            return true;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    return true;
+}
+
+// True if `c.in` holds a whole request (or a malformed header to act on).
+bool AllocatorServer::has_request(const Client& c) {
+    if (c.in.size() < sizeof(uint32_t)) return false;
+    uint32_t count;
+    memcpy(&count, c.in.data(), sizeof(count));
+    return count > MAX_OPS_PER_MESSAGE ||
+           c.in.size() >= sizeof(uint32_t) + (size_t)count * sizeof(WireOp);
+}
+
+void AllocatorServer::process_requests(Client& c) {
+    // drop the already-sent prefix so a steadily draining client does not
+    // keep its whole reply history
+    c.out.erase(c.out.begin(), c.out.begin() + c.out_pos);
+    c.out_pos = 0;
+
+    size_t pos = 0;
+    while (c.in.size() - pos >= sizeof(uint32_t) && c.out.size() < MAX_PENDING_OUTPUT) {
+        uint32_t count;
+        memcpy(&count, c.in.data() + pos, sizeof(count));
+        if (count > MAX_OPS_PER_MESSAGE) {
+            // malformed stream: stop reading and drop the client after flushing
+            c.in.clear();
+            c.closed = true;
+            return;
+        }
+        size_t msg_size = sizeof(uint32_t) + (size_t)count * sizeof(WireOp);
+        if (c.in.size() - pos < msg_size) break;
+
+        // reserve the word count, patch it once the batch is done
+        size_t header_at = c.out.size();
+        c.out.resize(header_at + sizeof(uint32_t));
+        uint32_t words = 0;
+
+        const char* ops = c.in.data() + pos + sizeof(uint32_t);
+        for (uint32_t i = 0; i < count; ++i) {
+            WireOp op;
+            memcpy(&op, ops + i * sizeof(WireOp), sizeof(op));
+            if (op.opcode == OpAlloc) {
+                append_word(c.out, allocate(op.arg));
+                words++;
+            } else if (op.opcode == OpFree) {
+                // ids are ints; a wider arg must not alias a real one
+                if (op.arg > (uint64_t)INT_MAX) append_word(c.out, -1);
+                else append_word(c.out, free_block((int)op.arg) ? 1 : 0);
+                words++;
+            } else if (op.opcode == OpStats) {
+                HeapStats stats = get_heap_stats();
+                append_word(c.out, stats.total_free);
+                append_word(c.out, stats.largest_free);
+                append_word(c.out, stats.fragments);
+                append_word(c.out, stats.used_blocks);
+                words += STATS_WORDS;
+            } else {
+                append_word(c.out, -1);
+                words++;
+            }
+        }
+        memcpy(c.out.data() + header_at, &words, sizeof(words));
+        pos += msg_size;
+    }
+    c.in.erase(c.in.begin(), c.in.begin() + pos);
+}
+
+bool AllocatorServer::write_client(int fd, Client& c) {
+    while (c.out_pos < c.out.size()) {
+        ssize_t n = send(fd, c.out.data() + c.out_pos, c.out.size() - c.out_pos, MSG_NOSIGNAL);
+        if (n > 0) {
+            c.out_pos += n;
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        if (n < 0 && errno == EINTR) continue;
+        return false;
+    }
+    c.out.clear();
+    c.out_pos = 0;
+    return true;
+}
+
+void AllocatorServer::update_interest(int fd, Client& c) {
+    // reading stops once the peer has closed its side (EOF would stay
+    // readable forever) or while too many replies are waiting for it
+    size_t pending = c.out.size() - c.out_pos;
+    uint32_t mask = 0;
+    if (!c.closed && pending < MAX_PENDING_OUTPUT) mask |= EPOLLIN;
+    if (pending > 0) mask |= EPOLLOUT;
+    if (mask == c.interest) return;
+    c.interest = mask;
+    epoll_event ev{};
+    ev.events = mask;
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+size_t AllocatorServer::buffered_bytes() const {
+    size_t total = 0;
+    for (const auto& entry : clients)
+        total += entry.second.in.size() + entry.second.out.size() - entry.second.out_pos;
+    return total;
+}
+
+void AllocatorServer::drop_client(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    clients.erase(fd);
+}
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop(int) {
+    stop_requested = 1;
+}
+
+int run_server(const string& path) {
+    AllocatorServer server;
+    if (!server.listen(path)) {
+        cerr << "Cannot listen on " << path << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    struct sigaction sa{};
+    sa.sa_handler = handle_stop;   // no SA_RESTART: epoll_wait returns EINTR
+    sigaction(SIGINT, &sa, nullptr);
+    sigaction(SIGTERM, &sa, nullptr);
+
+    cout << "Serving allocator on " << path << "\n" << flush;
+    while (!stop_requested) {
+        if (!server.poll_once(-1)) {
+            cerr << "epoll_wait failed: " << strerror(errno) << "\n";
+            return 1;
+        }
+    }
+    cout << "Server stopped\n";
+    return 0;
+}
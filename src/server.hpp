@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Binary protocol over a UNIX stream socket (native-endian, no padding):
+//
+//   request  = uint32 op_count, then op_count x WireOp
+//   response = uint32 word_count, then word_count x int64
+//
+// Each op appends its result words to the response in order:
+//   OpAlloc (arg = size) -> id, or -1 on failure
+//   OpFree  (arg = id)   -> 1 if freed, 0 otherwise, -1 if arg is not a valid id
+//   OpStats              -> total_free, largest_free, fragments, used_blocks
+// An unknown opcode appends -1.
+
+enum ServerOpcode : uint32_t {
+    OpAlloc = 1,
+    OpFree = 2,
+    OpStats = 3
+};
+
+struct WireOp {
+    uint32_t opcode;
+    uint32_t reserved;
+    uint64_t arg;
+};
+
+constexpr uint32_t MAX_OPS_PER_MESSAGE = 1 << 16;
+constexpr size_t STATS_WORDS = 4;
+
+// Single-threaded epoll server sharing the process heap between clients.
+class AllocatorServer {
+public:
+    AllocatorServer() = default;
+    ~AllocatorServer();
+    AllocatorServer(const AllocatorServer&) = delete;
+    AllocatorServer& operator=(const AllocatorServer&) = delete;
+
+    bool listen(const std::string& path);
+    // Waits up to timeout_ms for events and serves them; false on epoll error.
+    bool poll_once(int timeout_ms);
+    void close();
+
+    size_t client_count() const { return clients.size(); }
+    // Request and reply bytes held for all clients; bounded by backpressure.
+    size_t buffered_bytes() const;
+
+private:
+    struct Client {
+        std::vector<char> in;
+        std::vector<char> out;
+        size_t out_pos = 0;
+        uint32_t interest = 0;   // epoll events currently registered
+        bool closed = false;     // peer shut down its side, or sent garbage
+    };
+
+    void accept_clients();
+    bool read_client(int fd, Client& c);
+    bool write_client(int fd, Client& c);
+    static bool has_request(const Client& c);
+    void process_requests(Client& c);
+    void update_interest(int fd, Client& c);
+    void drop_client(int fd);
+
+    int listen_fd = -1;
+    int epoll_fd = -1;
+    std::string socket_path;
+    std::unordered_map<int, Client> clients;
+};
+
+// Serves on `path` until SIGINT/SIGTERM; returns a process exit code.
+int run_server(const std::string& path);
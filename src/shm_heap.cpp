@@ -0,0 +1,222 @@
+#include "shm_heap.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const uint64_t SHM_MAGIC = 0x4D52415348454150ULL;   // "MRASHEAP"
+static const size_t SHM_ALIGN = 16;
+
+static size_t align_up(size_t n, size_t a) {
+    return (n + a - 1) & ~(a - 1);
+}
+
+SharedHeap::~SharedHeap() {
+    detach();
+}
+
+bool SharedHeap::create(const string& name, size_t data_size, size_t max_blocks) {
+    detach();
+    if (data_size == 0 || max_blocks == 0) return false;
+
+    size_t blocks_offset = align_up(sizeof(ShmHeader), SHM_ALIGN);
+    size_t data_offset = align_up(blocks_offset + max_blocks * sizeof(ShmBlock), SHM_ALIGN);
+    size_t total = data_offset + align_up(data_size, SHM_ALIGN);
+
+    // never reuse an existing name: truncating a segment other processes
+    // still map would hand them SIGBUS on their next access
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) return false;
+    void* p = MAP_FAILED;
+    if (ftruncate(fd, total) == 0)
+        p = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+    base = static_cast<char*>(p);
+    length = total;
+
+    ShmHeader* h = header();
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&h->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    h->segment_size = total;
+    h->data_offset = data_offset;
+    h->data_size = data_size;
+    h->max_blocks = max_blocks;
+    h->next_id = 1;
+
+    // thread every record onto the spare list, then carve the initial free block
+    h->spare = SHM_NULL;
+    for (size_t i = max_blocks; i-- > 0;) {
+        uint64_t off = blocks_offset + i * sizeof(ShmBlock);
+        block(off)->next = h->spare;
+        h->spare = off;
+    }
+    uint64_t first = take_record();
+    *block(first) = ShmBlock{data_offset, data_size, SHM_NULL, SHM_NULL, 0, 0};
+    h->head = first;
+    h->block_count = 1;
+
+    // publish last: attachers check the magic before trusting anything else
+    __atomic_store_n(&h->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+    return true;
+}
+
+bool SharedHeap::attach(const string& name) {
+    detach();
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmHeader)) {
+        close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return false;
+    base = static_cast<char*>(p);
+    length = st.st_size;
+
+    if (__atomic_load_n(&header()->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC ||
+        header()->segment_size != length) {
+        detach();
+        return false;
+    }
+    return true;
+}
+
+void SharedHeap::detach() {
+    if (base) munmap(base, length);
+    base = nullptr;
+    length = 0;
+}
+
+bool SharedHeap::destroy(const string& name) {
+    return shm_unlink(name.c_str()) == 0;
+}
+
+void SharedHeap::lock() {
+    // a holder died while locked: recover the mutex rather than deadlock
+    // every other process on the segment
+    if (pthread_mutex_lock(&header()->lock) == EOWNERDEAD)
+        pthread_mutex_consistent(&header()->lock);
+}
+
+void SharedHeap::unlock() {
+    pthread_mutex_unlock(&header()->lock);
+}
+
+uint64_t SharedHeap::take_record() {
+    ShmHeader* h = header();
+    uint64_t off = h->spare;
+    if (off != SHM_NULL) h->spare = block(off)->next;
+    return off;
+}
+
+void SharedHeap::release_record(uint64_t off) {
+    ShmHeader* h = header();
+    block(off)->next = h->spare;
+    h->spare = off;
+}
+
+uint64_t SharedHeap::allocate(size_t size) {
+    // nothing larger fits, and the check keeps the rounding from wrapping
+    if (!base || size == 0 || size > header()->data_size) return SHM_NULL;
+    size = align_up(size, SHM_ALIGN);   // keep every data offset 16-byte aligned
+
+    lock();
+    ShmHeader* h = header();
+    uint64_t result = SHM_NULL;
+    for (uint64_t off = h->head; off != SHM_NULL; off = block(off)->next) {
+        ShmBlock* b = block(off);
+        if (b->used || b->size < size) continue;
+
+        if (b->size > size) {
+            // no record left to describe the remainder: only an exact fit
+            // further along can still be served
+            uint64_t rest_off = take_record();
+            if (rest_off == SHM_NULL) continue;
+            ShmBlock* rest = block(rest_off);
+            *rest = ShmBlock{b->start + size, b->size - size, b->next, off, 0, 0};
+            if (b->next != SHM_NULL) block(b->next)->prev = rest_off;
+            b->next = rest_off;
+            b->size = size;
+            h->block_count++;
+        }
+        b->used = 1;
+        b->id = h->next_id++;
+        result = b->start;
+        break;
+    }
+    unlock();
+    return result;
+}
+
+bool SharedHeap::free(uint64_t offset) {
+    if (!base) return false;
+
+    lock();
+    ShmHeader* h = header();
+    uint64_t off = h->head;
+    while (off != SHM_NULL && block(off)->start != offset) off = block(off)->next;
+
+    ShmBlock* b = block(off);
+    if (!b || !b->used) {
+        unlock();
+        return false;
+    }
+    b->used = 0;
+    b->id = 0;
+
+    // coalesce with the following, then the preceding free neighbour
+    ShmBlock* next = block(b->next);
+    if (next && !next->used) {
+        uint64_t next_off = b->next;
+        b->size += next->size;
+        b->next = next->next;
+        if (next->next != SHM_NULL) block(next->next)->prev = off;
+        release_record(next_off);
+        h->block_count--;
+    }
+    ShmBlock* prev = block(b->prev);
+    if (prev && !prev->used) {
+        prev->size += b->size;
+        prev->next = b->next;
+        if (b->next != SHM_NULL) block(b->next)->prev = b->prev;
+        release_record(off);
+        h->block_count--;
+    }
+    unlock();
+    return true;
+}
+
+ShmStats SharedHeap::stats() {
+    ShmStats s{};
+    if (!base) return s;
+
+    lock();
+    for (uint64_t off = header()->head; off != SHM_NULL; off = block(off)->next) {
+        const ShmBlock* b = block(off);
+        if (b->used) {
+            s.used_blocks++;
+        } else {
+            s.total_free += b->size;
+            s.largest_free = max<size_t>(s.largest_free, b->size);
+            s.fragments++;
+        }
+    }
+    unlock();
+    return s;
+}
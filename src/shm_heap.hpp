@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <pthread.h>
+
+// A first-fit heap whose metadata and bytes both live in one shm_open/mmap
+// segment, so several processes can allocate from and free into it. Every
+// reference inside the segment is a byte offset from the segment base, never
+// a pointer or vector index, so each process may map it at a different address.
+//
+//   [ShmHeader][ShmBlock x max_blocks][data bytes ...]
+
+constexpr uint64_t SHM_NULL = 0;   // offset 0 is the header, never a block or data
+
+struct ShmBlock {
+    uint64_t start;      // data offset from segment base
+    uint64_t size;
+    uint64_t next;       // ShmBlock offsets, address-ordered list
+    uint64_t prev;
+    uint32_t used;
+    int32_t id;
+};
+
+struct ShmHeader {
+    uint64_t magic;
+    pthread_mutex_t lock;     // PTHREAD_PROCESS_SHARED, robust
+    uint64_t segment_size;
+    uint64_t data_offset;
+    uint64_t data_size;
+    uint64_t max_blocks;
+    uint64_t head;            // first block in address order
+    uint64_t spare;           // singly linked list of unused ShmBlock records
+    uint64_t block_count;
+    int32_t next_id;
+    uint32_t reserved;
+};
+
+struct ShmStats {
+    size_t total_free;
+    size_t largest_free;
+    int fragments;
+    size_t used_blocks;
+};
+
+class SharedHeap {
+public:
+    SharedHeap() = default;
+    ~SharedHeap();
+    SharedHeap(const SharedHeap&) = delete;
+    SharedHeap& operator=(const SharedHeap&) = delete;
+
+    // Creates the named segment; name must start with '/'. Fails if the name
+    // already exists, so a live segment is never truncated under its users:
+    // attach() to it, or destroy() it first. max_blocks bounds the number of
+    // blocks, used and free, the heap can describe at once.
+    bool create(const std::string& name, size_t data_size, size_t max_blocks = 1024);
+    bool attach(const std::string& name);
+    void detach();
+    static bool destroy(const std::string& name);
+
+    // Returns the data offset of the new block, or SHM_NULL on failure. Once
+    // every record is in use, only a free block of exactly the rounded size
+    // can be handed out, however much space is free.
+    uint64_t allocate(size_t size);
+    bool free(uint64_t offset);
+
+    // Translates a data offset into this process's mapping.
+    void* at(uint64_t offset) const { return base + offset; }
+    ShmStats stats();
+    bool attached() const { return base != nullptr; }
+
+private:
+    ShmHeader* header() const { return reinterpret_cast<ShmHeader*>(base); }
+    ShmBlock* block(uint64_t off) const { return off ? reinterpret_cast<ShmBlock*>(base + off) : nullptr; }
+    uint64_t take_record();
+    void release_record(uint64_t off);
+    void lock();
+    void unlock();
+
+    char* base = nullptr;
+    size_t length = 0;
+};
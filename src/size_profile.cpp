@@ -0,0 +1,107 @@
+#include "heap_internal.hpp"
+#include <algorithm>
+
+using namespace std;
+
+// Sizes above this are counted but not binned; size classes never reach them.
+static const size_t PROFILE_MAX_SIZE = 4096;
+
+static bool profiling = false;
+static vector<uint64_t> histogram;   // request size -> count
+static size_t requests = 0;
+static vector<size_t> startup_classes;
+
+void set_size_profiling(bool enabled) {
+    profiling = enabled;
+}
+
+void clear_size_profile() {
+    histogram.clear();
+    requests = 0;
+}
+
+size_t profiled_requests() {
+    return requests;
+}
+
+void profile_request(size_t size) {
+    if (!profiling) return;
+    requests++;
+    if (size == 0 || size > PROFILE_MAX_SIZE) return;
+    if (histogram.size() <= size) histogram.resize(size + 1, 0);
+    histogram[size]++;
+}
+
+vector<size_t> derive_size_classes(size_t max_classes, size_t max_size) {
+    vector<size_t> sizes;
+    vector<uint64_t> counts;
+    for (size_t s = 1; s < histogram.size() && s <= max_size; ++s) {
+        if (histogram[s] == 0) continue;
+        sizes.push_back(s);
+        counts.push_back(histogram[s]);
+    }
+    size_t m = sizes.size();
+    if (m == 0 || max_classes == 0) return {};
+    size_t k = min(max_classes, m);
+
+    // prefix sums give the cost of serving sizes[a..b] from class sizes[b]:
+    // sizes[b] * count(a..b) - bytes(a..b)
+    vector<uint64_t> count_sum(m + 1, 0), byte_sum(m + 1, 0);
+    for (size_t i = 0; i < m; ++i) {
+        count_sum[i + 1] = count_sum[i] + counts[i];
+        byte_sum[i + 1] = byte_sum[i] + counts[i] * sizes[i];
+    }
+    auto cost = [&](size_t a, size_t b) {
+        return sizes[b] * (count_sum[b + 1] - count_sum[a]) - (byte_sum[b + 1] - byte_sum[a]);
+    };
+
+    // best[j][b]: least waste covering sizes[0..b] with j + 1 classes, the
+    // last one being sizes[b]; from[j][b] is where that last class begins
+    const uint64_t INF = UINT64_MAX;
+    vector<vector<uint64_t>> best(k, vector<uint64_t>(m, INF));
+    vector<vector<size_t>> from(k, vector<size_t>(m, 0));
+    for (size_t b = 0; b < m; ++b) best[0][b] = cost(0, b);
+    for (size_t j = 1; j < k; ++j) {
+        for (size_t b = j; b < m; ++b) {
+            for (size_t a = j; a <= b; ++a) {
+                if (best[j - 1][a - 1] == INF) continue;
+                uint64_t total = best[j - 1][a - 1] + cost(a, b);
+                if (total < best[j][b]) {
+                    best[j][b] = total;
+                    from[j][b] = a;
+                }
+            }
+        }
+    }
+
+    // fewer classes can never beat more, but ties keep the table smaller
+    size_t used = 0;
+    for (size_t j = 1; j < k; ++j)
+        if (best[j][m - 1] < best[used][m - 1]) used = j;
+
+    vector<size_t> classes;
+    for (size_t j = used + 1, b = m - 1; j-- > 0;) {
+        classes.push_back(sizes[b]);
+        if (j > 0) b = from[j][b] - 1;
+    }
+    reverse(classes.begin(), classes.end());
+    return classes;
+}
+
+size_t size_class_waste(const vector<size_t>& classes) {
+    size_t waste = 0;
+    for (size_t s = 1; s < histogram.size(); ++s) {
+        if (histogram[s] == 0) continue;
+        auto it = lower_bound(classes.begin(), classes.end(), s);
+        if (it != classes.end()) waste += (*it - s) * histogram[s];
+    }
+    return waste;
+}
+
+void set_startup_size_classes(const vector<size_t>& classes) {
+    startup_classes = classes;
+}
+
+void load_startup_size_classes() {
+    if (!startup_classes.empty()) set_size_classes(startup_classes);
+}
@@ -0,0 +1,171 @@
+#include "snapshot.hpp"
+#include "heap_internal.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+HeapImage::~HeapImage() {
+    close();
+}
+
+bool HeapImage::open(const string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    base = p;
+    length = st.st_size;
+
+    // validate before anyone dereferences offsets from the file; the table
+    // bounds are checked by division so a huge count cannot wrap around
+    const SnapshotHeader& h = header();
+    bool ok = memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) == 0 &&
+              h.version == SNAPSHOT_VERSION &&
+              h.file_size == length &&
+              h.blocks_offset % alignof(SnapshotBlock) == 0 &&
+              h.index_offset % alignof(SnapshotIndexEntry) == 0 &&
+              h.blocks_offset <= length &&
+              h.block_count <= (length - h.blocks_offset) / sizeof(SnapshotBlock) &&
+              h.index_offset <= length &&
+              h.index_count <= (length - h.index_offset) / sizeof(SnapshotIndexEntry);
+    for (uint64_t i = 0; ok && i < h.index_count; ++i)
+        ok = index()[i].block < h.block_count;
+    if (!ok) close();
+    return ok;
+}
+
+void HeapImage::close() {
+    if (base) munmap(base, length);
+    base = nullptr;
+    length = 0;
+}
+
+const SnapshotHeader& HeapImage::header() const {
+    return *static_cast<const SnapshotHeader*>(base);
+}
+
+const SnapshotBlock* HeapImage::blocks() const {
+    return reinterpret_cast<const SnapshotBlock*>(
+        static_cast<const char*>(base) + header().blocks_offset);
+}
+
+const SnapshotIndexEntry* HeapImage::index() const {
+    return reinterpret_cast<const SnapshotIndexEntry*>(
+        static_cast<const char*>(base) + header().index_offset);
+}
+
+const SnapshotBlock* HeapImage::find(int id) const {
+    const SnapshotIndexEntry* first = index();
+    const SnapshotIndexEntry* last = first + header().index_count;
+    auto it = lower_bound(first, last, id,
+        [](const SnapshotIndexEntry& e, int key) { return e.id < key; });
+    if (it == last || it->id != id) return nullptr;
+    return blocks() + it->block;
+}
+
+bool save_heap(const string& path) {
+    // slabs and huge spans live outside the block list and are not captured
+    if (get_huge_stats().region_bytes > 0) return false;
+    for (const auto& b : memory)
+        if (b.id == SLAB_BLOCK_ID) return false;
+
+    vector<SnapshotBlock> blocks;
+    vector<SnapshotIndexEntry> index;
+    blocks.reserve(memory.size());
+    for (size_t i = 0; i < memory.size(); ++i) {
+        const Block& b = memory[i];
+        blocks.push_back({b.start, b.size, b.id, b.used ? 1u : 0u});
+        if (b.used) index.push_back({b.id, (uint32_t)i});
+    }
+    sort(index.begin(), index.end(),
+         [](const SnapshotIndexEntry& a, const SnapshotIndexEntry& b) { return a.id < b.id; });
+
+    SnapshotHeader h{};
+    memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+    h.version = SNAPSHOT_VERSION;
+    h.strategy = current_strategy;
+    h.memory_size = heap_size;
+    h.next_id = next_id;
+    h.block_count = blocks.size();
+    h.blocks_offset = sizeof(SnapshotHeader);
+    h.index_count = index.size();
+    h.index_offset = h.blocks_offset + blocks.size() * sizeof(SnapshotBlock);
+    h.file_size = h.index_offset + index.size() * sizeof(SnapshotIndexEntry);
+
+    // write next to the target and rename, so a crash never leaves a torn image
+    string tmp = path + ".tmp";
+    {
+        ofstream out(tmp, ios::binary | ios::trunc);
+        if (!out) return false;
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(SnapshotBlock));
+        out.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(SnapshotIndexEntry));
+        if (!out) return false;
+    }
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// The blocks must tile [0, memory_size) in address order with no gaps or
+// overlaps, and every used block must carry a distinct id the counter has
+// issued; free_block() would otherwise release whichever duplicate is first.
+static bool image_is_consistent(const HeapImage& image) {
+    const SnapshotHeader& h = image.header();
+    if (h.memory_size < MEMORY_SIZE || h.strategy > Stack) return false;
+    if (h.next_id < 1 || h.next_id > INT_MAX) return false;
+
+    const SnapshotBlock* blocks = image.blocks();
+    vector<int> ids;
+    uint64_t end = 0;
+    for (uint64_t i = 0; i < h.block_count; ++i) {
+        const SnapshotBlock& b = blocks[i];
+        if (b.start != end || b.size == 0 || b.size > h.memory_size - end) return false;
+        if (b.used > 1 || (b.used && (b.id <= 0 || b.id >= h.next_id))) return false;
+        if (b.used) ids.push_back(b.id);
+        end = b.start + b.size;
+    }
+    sort(ids.begin(), ids.end());
+    return end == h.memory_size && adjacent_find(ids.begin(), ids.end()) == ids.end();
+}
+
+bool load_heap(const string& path) {
+    HeapImage image;
+    if (!image.open(path) || !image_is_consistent(image)) return false;
+
+    // same full reset as initialize_memory(), sized for the image; the huge
+    // region is not part of a snapshot, so it goes too
+    const SnapshotHeader& h = image.header();
+    reset_heap(h.memory_size);
+    set_huge_region(0, 0);
+
+    const SnapshotBlock* blocks = image.blocks();
+    memory.clear();
+    memory.reserve(h.block_count);
+    for (uint64_t i = 0; i < h.block_count; ++i) {
+        memory.push_back(Block(blocks[i].start, blocks[i].size, blocks[i].used != 0, blocks[i].id));
+        if (blocks[i].used) pages_touch(blocks[i].start, blocks[i].size);
+    }
+    invalidate_free_index();
+
+    current_strategy = (AllocationStrategy)h.strategy;
+    next_id = (int)h.next_id;
+    return true;
+}
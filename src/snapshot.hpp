@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// On-disk heap snapshot. Every field is fixed width and every reference is a
+// byte offset from the start of the file, so a mapped image can be used in
+// place at any address. Multi-byte fields are native-endian.
+//
+//   [SnapshotHeader][SnapshotBlock x block_count][SnapshotIndexEntry x index_count]
+
+constexpr char SNAPSHOT_MAGIC[8] = {'M', 'R', 'A', 'H', 'E', 'A', 'P', '1'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t strategy;
+    uint64_t memory_size;
+    int64_t next_id;
+    uint64_t block_count;
+    uint64_t blocks_offset;
+    uint64_t index_count;
+    uint64_t index_offset;
+    uint64_t file_size;
+};
+
+struct SnapshotBlock {
+    uint64_t start;
+    uint64_t size;
+    int32_t id;
+    uint32_t used;
+};
+
+// ID index: used blocks sorted by id, pointing at their block record.
+struct SnapshotIndexEntry {
+    int32_t id;
+    uint32_t block;
+};
+
+// Read-only view of a snapshot file mapped with mmap. Nothing is parsed or
+// copied; accessors point straight into the mapping.
+class HeapImage {
+public:
+    HeapImage() = default;
+    ~HeapImage();
+    HeapImage(const HeapImage&) = delete;
+    HeapImage& operator=(const HeapImage&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const SnapshotHeader& header() const;
+    const SnapshotBlock* blocks() const;
+    const SnapshotIndexEntry* index() const;
+    const SnapshotBlock* find(int id) const;   // O(log n) via the ID index
+
+private:
+    void* base = nullptr;
+    size_t length = 0;
+};
+
+bool save_heap(const std::string& path);
+bool load_heap(const std::string& path);
@@ -0,0 +1,35 @@
+#include "heap_internal.hpp"
+
+using namespace std;
+
+// The stack grows up through the last free block of `memory`; everything
+// below the top allocation is either live or a hole left from before the
+// strategy switch, and is never searched.
+
+int allocate_stack(size_t size) {
+    if (memory.empty() || memory.back().used || memory.back().size < size) return -1;
+    int id = take_id();
+    place_block(memory.size() - 1, size, id);
+    return id;
+}
+
+int stack_top_index() {
+    int i = (int)memory.size() - 1;
+    if (i >= 0 && !memory[i].used) i--;
+    if (i < 0 || !memory[i].used || memory[i].id == SLAB_BLOCK_ID) return -1;
+    return i;
+}
+
+size_t push_marker() {
+    if (current_strategy != Stack || memory.empty()) return SIZE_MAX;
+    const Block& last = memory.back();
+    return last.used ? last.start + last.size : last.start;
+}
+
+bool pop_to_marker(size_t marker) {
+    if (current_strategy != Stack || marker > push_marker()) return false;
+    for (int top = stack_top_index(); top != -1 && memory[top].start >= marker;
+         top = stack_top_index())
+        release_block(top);
+    return true;
+}
@@ -0,0 +1,157 @@
+#include "tagged_heap.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+static size_t align_up(size_t n, size_t a) {
+    return (n + a - 1) & ~(a - 1);
+}
+
+uint64_t TaggedHeap::load(size_t off) const {
+    uint64_t value;
+    memcpy(&value, buffer.data() + off, sizeof(value));
+    return value;
+}
+
+void TaggedHeap::store(size_t off, uint64_t value) {
+    memcpy(buffer.data() + off, &value, sizeof(value));
+}
+
+void TaggedHeap::set_tags(size_t block, size_t size, bool used) {
+    uint64_t tag = size | (used ? 1 : 0);
+    store(block, tag);
+    store(block + size - TAG_SIZE, tag);
+}
+
+// free-list links sit in the first two payload words: next, then prev
+void TaggedHeap::list_push(size_t block) {
+    store(block + TAG_SIZE, free_head);
+    store(block + 2 * TAG_SIZE, TAG_NULL);
+    if (free_head != TAG_NULL) store(free_head + 2 * TAG_SIZE, block);
+    free_head = block;
+}
+
+void TaggedHeap::list_remove(size_t block) {
+    size_t next = load(block + TAG_SIZE);
+    size_t prev = load(block + 2 * TAG_SIZE);
+    if (prev != TAG_NULL) store(prev + TAG_SIZE, next);
+    else free_head = next;
+    if (next != TAG_NULL) store(next + 2 * TAG_SIZE, prev);
+}
+
+void TaggedHeap::reset(size_t bytes) {
+    bytes = bytes / ALIGN * ALIGN;
+    free_head = TAG_NULL;
+    if (bytes < 2 * TAG_SIZE + MIN_BLOCK) {
+        buffer.clear();
+        first_block = epilogue = 0;
+        return;
+    }
+
+    // the leading pad puts every header at 8 mod 16, so payloads are 16-aligned
+    buffer.assign(bytes, 0);
+    first_block = TAG_SIZE;
+    epilogue = bytes - TAG_SIZE;
+    set_tags(first_block, epilogue - first_block, false);
+    store(epilogue, 1);
+    list_push(first_block);
+}
+
+size_t TaggedHeap::allocate(size_t size) {
+    // nothing larger fits anyway, and it keeps the rounding below from wrapping
+    if (size > capacity()) return TAG_NULL;
+    size_t need = max(MIN_BLOCK, align_up(size + 2 * TAG_SIZE, ALIGN));
+    for (size_t block = free_head; block != TAG_NULL; block = load(block + TAG_SIZE)) {
+        size_t have = tag_size(load(block));
+        if (have < need) continue;
+
+        list_remove(block);
+        if (have - need >= MIN_BLOCK) {
+            set_tags(block + need, have - need, false);
+            list_push(block + need);
+        } else {
+            need = have;
+        }
+        set_tags(block, need, true);
+        return block + TAG_SIZE;
+    }
+    return TAG_NULL;
+}
+
+bool TaggedHeap::free(size_t offset) {
+    if (offset < first_block + TAG_SIZE || offset >= epilogue || offset % ALIGN != 0)
+        return false;
+    size_t block = offset - TAG_SIZE;
+    uint64_t tag = load(block);
+    size_t size = tag_size(tag);
+    if (!tag_used(tag) || size < MIN_BLOCK || block + size > epilogue ||
+        load(block + size - TAG_SIZE) != tag)
+        return false;
+
+    // neighbours come straight from the tags: next header, previous footer
+    size_t next = block + size;
+    uint64_t next_tag = load(next);
+    if (!tag_used(next_tag)) {
+        list_remove(next);
+        size += tag_size(next_tag);
+    }
+    if (block > first_block) {
+        uint64_t prev_tag = load(block - TAG_SIZE);
+        if (!tag_used(prev_tag)) {
+            block -= tag_size(prev_tag);
+            size += tag_size(prev_tag);
+            list_remove(block);
+        }
+    }
+    set_tags(block, size, false);
+    list_push(block);
+    return true;
+}
+
+TagStats TaggedHeap::stats() const {
+    TagStats s{};
+    for (size_t block = first_block; block < epilogue; block += tag_size(load(block))) {
+        uint64_t tag = load(block);
+        if (tag_used(tag)) {
+            s.used_blocks++;
+        } else {
+            size_t payload = tag_size(tag) - 2 * TAG_SIZE;
+            s.total_free += payload;
+            s.largest_free = max(s.largest_free, payload);
+            s.fragments++;
+        }
+        s.tag_bytes += 2 * TAG_SIZE;
+    }
+    return s;
+}
+
+bool TaggedHeap::check() const {
+    if (buffer.empty()) return free_head == TAG_NULL;
+    if (load(epilogue) != 1) return false;
+
+    size_t free_blocks = 0;
+    bool prev_free = false;
+    size_t block = first_block;
+    while (block < epilogue) {
+        uint64_t tag = load(block);
+        size_t size = tag_size(tag);
+        if (size < MIN_BLOCK || block + size > epilogue) return false;
+        if (load(block + size - TAG_SIZE) != tag) return false;
+        bool is_free = !tag_used(tag);
+        if (is_free && prev_free) return false;   // missed coalesce
+        if (is_free) free_blocks++;
+        prev_free = is_free;
+        block += size;
+    }
+    if (block != epilogue) return false;
+
+    size_t listed = 0;
+    size_t prev = TAG_NULL;
+    for (size_t b = free_head; b != TAG_NULL; b = load(b + TAG_SIZE)) {
+        if (tag_used(load(b)) || load(b + 2 * TAG_SIZE) != prev) return false;
+        if (++listed > free_blocks) return false;
+        prev = b;
+    }
+    return listed == free_blocks;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A heap whose metadata lives in-band, dlmalloc-style: every block carries an
+// 8-byte header tag before its payload and a copy of it as a footer in its
+// last word, each holding the block size with the used flag in bit 0. Free
+// reads the next block's header and the previous block's footer, so
+// coalescing is O(1) and never consults an out-of-band list. Free blocks are
+// also threaded on an explicit LIFO free list through their payloads.
+// A self-contained heap beside the simulated one: no strategy uses it, but the
+// CLI's `tagged` commands and the benchmark run it.
+//
+//   [pad 8][hdr | payload ... | ftr][hdr | ... | ftr] ... [epilogue hdr]
+
+constexpr size_t TAG_NULL = 0;   // offset 0 is padding, never a payload
+
+struct TagStats {
+    size_t total_free;
+    size_t largest_free;
+    int fragments;
+    size_t used_blocks;
+    size_t tag_bytes;      // header + footer words for every block
+};
+
+class TaggedHeap {
+public:
+    static constexpr size_t ALIGN = 16;
+    static constexpr size_t TAG_SIZE = 8;
+    static constexpr size_t MIN_BLOCK = 32;   // tags + two free-list links
+
+    explicit TaggedHeap(size_t bytes = 0) { reset(bytes); }
+
+    // Discards everything and formats `bytes` (rounded down to ALIGN) as one
+    // free block.
+    void reset(size_t bytes);
+
+    // Returns the payload offset of the new block, or TAG_NULL on failure.
+    size_t allocate(size_t size);
+    // Rejects offsets that do not name a live payload, including double frees.
+    bool free(size_t offset);
+
+    void* at(size_t offset) { return buffer.data() + offset; }
+    size_t block_size(size_t offset) const { return tag_size(load(offset - TAG_SIZE)); }
+    size_t capacity() const { return buffer.size(); }
+
+    TagStats stats() const;
+    // Walks every block and verifies header/footer agreement, that no two free
+    // blocks are adjacent and that the free list covers exactly the free blocks.
+    bool check() const;
+
+private:
+    static size_t tag_size(uint64_t tag) { return tag & ~uint64_t(ALIGN - 1); }
+    static bool tag_used(uint64_t tag) { return tag & 1; }
+
+    uint64_t load(size_t off) const;
+    void store(size_t off, uint64_t value);
+    void set_tags(size_t block, size_t size, bool used);
+    void list_push(size_t block);
+    void list_remove(size_t block);
+
+    std::vector<unsigned char> buffer;
+    size_t first_block = 0;    // offset of the first header
+    size_t epilogue = 0;       // offset of the zero-size used header at the end
+    size_t free_head = TAG_NULL;   // block offsets, not payloads
+};
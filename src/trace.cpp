@@ -0,0 +1,218 @@
+#include "heap_internal.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+using namespace std;
+
+bool tracing = false;
+
+namespace {
+
+struct TraceEvent {
+    TraceKind kind;
+    uint64_t ts;      // ns since trace_start()
+    uint64_t dur;
+    int64_t args[3];
+};
+
+struct KindInfo {
+    const char* name;
+    char phase;              // X = complete, i = instant, C = counter
+    const char* keys[3];     // nullptr = unused
+};
+
+const KindInfo KINDS[] = {
+    {"allocate",   'X', {"id", "size", "offset"}},
+    {"free_block", 'X', {"id", "ok", nullptr}},
+    {"free_at",    'X', {"offset", "ok", nullptr}},
+    {"split",      'i', {"start", "size", "rest"}},
+    {"merge",      'i', {"start", "size", nullptr}},
+    {"grow_heap",  'X', {"bytes", "heap_size", nullptr}},
+    {"trim_heap",  'X', {"bytes", "heap_size", nullptr}},
+    {"heap",       'C', {"used", "free", nullptr}},
+};
+
+// Single-producer single-consumer ring: the allocator thread only stores an
+// event and publishes head; the writer thread formats and writes behind it.
+// When the writer falls a full ring behind, new events are dropped and
+// counted rather than stalling the allocator.
+constexpr size_t RING_SIZE = 1 << 16;
+TraceEvent ring[RING_SIZE];
+alignas(64) atomic<size_t> head{0};
+alignas(64) atomic<size_t> tail{0};
+
+atomic<bool> running{false};
+thread writer;
+FILE* out = nullptr;
+chrono::steady_clock::time_point epoch;
+size_t used_bytes = 0;
+size_t reported_used = SIZE_MAX;    // last occupancy sent as a counter
+size_t reported_heap = 0;
+TraceStats totals;                  // recorded and dropped: allocator thread
+atomic<size_t> written{0};          // writer thread
+
+// The writer formats by hand into one buffer per drain; printf-style
+// formatting of every field was most of the tracing cost.
+char text[1 << 16];
+size_t text_len = 0;
+
+void put(const char* s) {
+    while (*s) text[text_len++] = *s++;
+}
+
+void put_int(int64_t v) {
+    char digits[24];
+    int n = 0;
+    uint64_t u = v < 0 ? 0 - (uint64_t)v : v;
+    do digits[n++] = '0' + u % 10; while (u /= 10);
+    if (v < 0) text[text_len++] = '-';
+    while (n) text[text_len++] = digits[--n];
+}
+
+// ns as microseconds with three decimals, the unit the format expects
+void put_us(uint64_t ns) {
+    put_int(ns / 1000);
+    uint64_t frac = ns % 1000;
+    text[text_len++] = '.';
+    text[text_len++] = '0' + frac / 100;
+    text[text_len++] = '0' + frac / 10 % 10;
+    text[text_len++] = '0' + frac % 10;
+}
+
+void write_event(const TraceEvent& e) {
+    const KindInfo& k = KINDS[e.kind];
+    if (text_len > sizeof(text) - 512) {
+        fwrite(text, 1, text_len, out);
+        text_len = 0;
+    }
+    put(",\n{\"name\":\"");
+    put(k.name);
+    put("\",\"cat\":\"heap\",\"ph\":\"");
+    text[text_len++] = k.phase;
+    put("\",\"ts\":");
+    put_us(e.ts);
+    if (k.phase == 'X') {
+        put(",\"dur\":");
+        put_us(e.dur);
+    }
+    if (k.phase == 'i') put(",\"s\":\"t\"");
+    put(",\"pid\":1,\"tid\":1,\"args\":{");
+    for (int i = 0; i < 3 && k.keys[i]; ++i) {
+        put(i ? ",\"" : "\"");
+        put(k.keys[i]);
+        put("\":");
+        put_int(e.args[i]);
+    }
+    put("}}");
+}
+
+bool drain() {
+    size_t h = head.load(memory_order_acquire);
+    size_t t = tail.load(memory_order_relaxed);
+    for (size_t i = t; i != h; ++i) write_event(ring[i & (RING_SIZE - 1)]);
+    fwrite(text, 1, text_len, out);
+    text_len = 0;
+    tail.store(h, memory_order_release);
+    written.fetch_add(h - t, memory_order_relaxed);
+    return h != t;
+}
+
+void writer_loop() {
+    while (running.load(memory_order_acquire))
+        if (!drain()) this_thread::sleep_for(chrono::milliseconds(1));
+    drain();
+}
+
+}  // namespace
+
+uint64_t trace_now() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now() - epoch).count();
+}
+
+void trace_record(TraceKind kind, uint64_t start, int64_t a, int64_t b, int64_t c) {
+    size_t h = head.load(memory_order_relaxed);
+    totals.recorded++;
+    if (h - tail.load(memory_order_acquire) == RING_SIZE) {
+        totals.dropped++;
+        return;
+    }
+    uint64_t now = trace_now();
+    TraceEvent& e = ring[h & (RING_SIZE - 1)];
+    e.kind = kind;
+    e.ts = KINDS[kind].phase == 'X' ? start : now;
+    e.dur = KINDS[kind].phase == 'X' ? now - start : 0;
+    e.args[0] = a;
+    e.args[1] = b;
+    e.args[2] = c;
+    head.store(h + 1, memory_order_release);
+}
+
+void trace_used(long long delta) {
+    used_bytes += delta;
+}
+
+void trace_heap() {
+    // failed and rejected operations change nothing; skip the repeat
+    if (used_bytes == reported_used && heap_size == reported_heap) return;
+    reported_used = used_bytes;
+    reported_heap = heap_size;
+    trace_record(TraceHeap, 0, used_bytes, heap_size - used_bytes, 0);
+}
+
+void trace_recount() {
+    used_bytes = get_huge_stats().used_bytes;
+    for (const auto& block : memory)
+        if (block.used) used_bytes += block.size;
+}
+
+bool trace_start(const char* path) {
+    if (tracing) return false;
+    out = fopen(path, "w");
+    if (!out) return false;
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+          "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"allocator\"}}", out);
+
+    epoch = chrono::steady_clock::now();
+    head.store(0);
+    tail.store(0);
+    totals = TraceStats{};
+    written.store(0);
+    trace_recount();
+    reported_used = SIZE_MAX;
+    running.store(true, memory_order_release);
+    writer = thread(writer_loop);
+    tracing = true;
+    trace_heap();
+    return true;
+}
+
+namespace {
+
+// Exiting with a trace running would destroy a joinable std::thread
+// (std::terminate) and leave the JSON array open; finish the trace instead.
+// Declared after `writer`, so it is destroyed first.
+struct TraceExitGuard {
+    ~TraceExitGuard() { trace_stop(); }
+} exit_guard;
+
+}  // namespace
+
+size_t trace_stop() {
+    if (!tracing) return 0;
+    tracing = false;
+    running.store(false, memory_order_release);
+    writer.join();
+    fputs("\n]}\n", out);
+    fclose(out);
+    out = nullptr;
+    return written.load();
+}
+
+TraceStats get_trace_stats() {
+    TraceStats s = totals;
+    s.written = written.load(memory_order_relaxed);
+    return s;
+}
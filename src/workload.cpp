@@ -0,0 +1,155 @@
+#include "workload.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+SplitMix64::SplitMix64(uint64_t seed) : state(seed) {}
+
+uint64_t SplitMix64::next() {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+Xoshiro256::Xoshiro256(uint64_t seed) {
+    SplitMix64 sm(seed);
+    for (auto& word : s) word = sm.next();
+}
+
+uint64_t Xoshiro256::next() {
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+uint64_t Xoshiro256::below(uint64_t n) {
+    // Lemire's multiply-shift range reduction, no division on the hot path.
+    return (uint64_t)(((unsigned __int128)next() * n) >> 64);
+}
+
+double Xoshiro256::uniform() {
+    return (next() >> 11) * 0x1.0p-53;
+}
+
+WorkloadGenerator::WorkloadGenerator(const WorkloadConfig& cfg)
+    : config(cfg), rng(cfg.seed) {
+    if (config.max_alloc < 1) config.max_alloc = 1;
+}
+
+size_t WorkloadGenerator::draw_size() {
+    size_t max_alloc = config.max_alloc;
+    switch (config.sizes) {
+    case BimodalSizes: {
+        // 80% small (up to 1/8 of max), 20% large (upper half of range)
+        size_t small_max = max<size_t>(1, max_alloc / 8);
+        if (rng.below(10) < 8)
+            return 1 + rng.below(small_max);
+        size_t large_min = max<size_t>(1, max_alloc / 2);
+        return large_min + rng.below(max_alloc - large_min + 1);
+    }
+    case PowerLawSizes: {
+        // Pareto with alpha = 1.5 and a 4-byte minimum, clamped to max_alloc
+        double u = 1.0 - rng.uniform();
+        double size = 4.0 * pow(u, -1.0 / 1.5);
+        return min<size_t>(max_alloc, (size_t)size);
+    }
+    case UniformSizes:
+    default:
+        return 1 + rng.below(max_alloc);
+    }
+}
+
+double WorkloadGenerator::alloc_probability() {
+    if (config.pattern != RampPeakPlateau) return 0.5;
+
+    // ramp: first 30% of ops, peak burst: next 20%, then drain to a plateau
+    // at half the peak live count and hold it there.
+    if (step < config.ops * 3 / 10) return 0.75;
+    if (step < config.ops / 2) {
+        peak_live = max(peak_live, live.size());
+        return 0.9;
+    }
+    return live.size() > peak_live / 2 ? 0.25 : 0.5;
+}
+
+WorkloadOp WorkloadGenerator::next() {
+    double p_alloc = alloc_probability();
+    step++;
+
+    if ((live.empty() && long_live.empty()) || rng.uniform() < p_alloc) {
+        size_t seq = next_seq++;
+        bool long_lived = config.pattern == MixedLifetime && rng.below(5) == 0;
+        (long_lived ? long_live : live).push_back(seq);
+        return {true, draw_size(), 0, long_lived};
+    }
+
+    size_t victim;
+    if (config.pattern == MixedLifetime && !long_live.empty() &&
+        (live.empty() || rng.below(20) == 0)) {
+        // long-lived objects do die, just rarely and oldest first
+        victim = long_live.front();
+        long_live.pop_front();
+    } else if (config.pattern == ProducerConsumer) {
+        victim = live.front();
+        live.pop_front();
+    } else if (config.pattern == StackLifo) {
+        victim = live.back();
+        live.pop_back();
+    } else {
+        size_t idx = rng.below(live.size());
+        victim = live[idx];
+        live[idx] = live.back();
+        live.pop_back();
+    }
+    return {false, 0, victim, false};
+}
+
+bool parse_workload_pattern(const string& name, WorkloadPattern& out) {
+    if (name == "random") out = RandomMix;
+    else if (name == "ramp") out = RampPeakPlateau;
+    else if (name == "fifo") out = ProducerConsumer;
+    else if (name == "lifo") out = StackLifo;
+    else if (name == "mixed") out = MixedLifetime;
+    else return false;
+    return true;
+}
+
+bool parse_size_distribution(const string& name, SizeDistribution& out) {
+    if (name == "uniform") out = UniformSizes;
+    else if (name == "bimodal") out = BimodalSizes;
+    else if (name == "powerlaw") out = PowerLawSizes;
+    else return false;
+    return true;
+}
+
+const char* workload_pattern_name(WorkloadPattern pattern) {
+    switch (pattern) {
+    case RampPeakPlateau: return "ramp";
+    case ProducerConsumer: return "fifo";
+    case StackLifo: return "lifo";
+    case MixedLifetime: return "mixed";
+    case RandomMix:
+    default: return "random";
+    }
+}
+
+const char* size_distribution_name(SizeDistribution sizes) {
+    switch (sizes) {
+    case BimodalSizes: return "bimodal";
+    case PowerLawSizes: return "powerlaw";
+    case UniformSizes:
+    default: return "uniform";
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// SplitMix64: tiny seeding generator, also used to expand a single seed
+// into the larger xoshiro state.
+struct SplitMix64 {
+    uint64_t state;
+
+    explicit SplitMix64(uint64_t seed);
+    uint64_t next();
+};
+
+// xoshiro256**: fast, statistically solid PRNG for workload generation.
+struct Xoshiro256 {
+    uint64_t s[4];
+
+    explicit Xoshiro256(uint64_t seed);
+    uint64_t next();
+    uint64_t below(uint64_t n);   // uniform in [0, n)
+    double uniform();             // uniform in [0, 1)
+};
+
+// Lifetime / phase shape of the operation stream.
+enum WorkloadPattern {
+    RandomMix,         // 50/50 alloc/free, random victim (legacy benchmark)
+    RampPeakPlateau,   // grow, burst to a peak, drain to a steady plateau
+    ProducerConsumer,  // FIFO lifetimes: oldest allocation dies first
+    StackLifo,         // LIFO lifetimes: newest allocation dies first
+    MixedLifetime      // 1 in 5 allocations is long-lived and rarely freed
+};
+
+// Distribution of request sizes.
+enum SizeDistribution {
+    UniformSizes,      // 1 .. max_alloc
+    BimodalSizes,      // mostly small headers, some large buffers
+    PowerLawSizes      // heavy tail: many tiny requests, few huge ones
+};
+
+struct WorkloadConfig {
+    WorkloadPattern pattern = RandomMix;
+    SizeDistribution sizes = UniformSizes;
+    int ops = 1000;
+    int max_alloc = 200;
+    uint64_t seed = 42;
+};
+
+struct WorkloadOp {
+    bool alloc;      // true = allocate, false = free
+    size_t size;     // request size (alloc only)
+    size_t target;   // sequence number of the allocation to free (free only)
+    bool long_lived; // MixedLifetime: the generator will keep it around
+};
+
+// Produces a deterministic stream of operations for a config. Frees refer to
+// allocations by their sequence number, so every strategy replays exactly the
+// same workload regardless of which of its allocations succeed.
+class WorkloadGenerator {
+public:
+    explicit WorkloadGenerator(const WorkloadConfig& config);
+
+    WorkloadOp next();
+    size_t allocations() const { return next_seq; }
+
+private:
+    size_t draw_size();
+    double alloc_probability();
+
+    WorkloadConfig config;
+    Xoshiro256 rng;
+    std::deque<size_t> live;   // sequence numbers, oldest at the front
+    std::deque<size_t> long_live;   // MixedLifetime long-lived allocations
+    size_t next_seq = 0;
+    int step = 0;
+    size_t peak_live = 0;
+};
+
+bool parse_workload_pattern(const std::string& name, WorkloadPattern& out);
+bool parse_size_distribution(const std::string& name, SizeDistribution& out);
+const char* workload_pattern_name(WorkloadPattern pattern);
+const char* size_distribution_name(SizeDistribution sizes);
@@ -1,7 +1,24 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 #include "../src/allocator.hpp"
+#include "../src/snapshot.hpp"
+#include "../src/batch.hpp"
+#include "../src/server.hpp"
+#include "../src/shm_heap.hpp"
+#include "../src/block_tree.hpp"
+#include "../src/tagged_heap.hpp"
+#include "../src/cache_sim.hpp"
+#include "../src/perf_counters.hpp"
+#include <climits>
 #include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
 using namespace std;
 
 //
@@ -192,3 +209,1425 @@ TEST_CASE("Buddy allocator split and merge", "[buddy]") {
     REQUIRE(total_size == MEMORY_SIZE);
     REQUIRE(memory.size() == 1); // fully merged back
 }
+
+TEST_CASE("Workload generator is deterministic and honours lifetimes", "[workload]") {
+    WorkloadConfig config;
+    config.pattern = StackLifo;
+    config.sizes = BimodalSizes;
+    config.ops = 500;
+    config.seed = 7;
+
+    WorkloadGenerator a(config), b(config);
+    vector<size_t> live;
+    for (int i = 0; i < config.ops; i++) {
+        WorkloadOp x = a.next();
+        WorkloadOp y = b.next();
+        REQUIRE(x.alloc == y.alloc);
+        REQUIRE(x.size == y.size);
+        REQUIRE(x.target == y.target);
+
+        if (x.alloc) {
+            REQUIRE(x.size >= 1);
+            REQUIRE(x.size <= (size_t)config.max_alloc);
+            live.push_back(a.allocations() - 1);
+        } else {
+            // LIFO: the most recent live allocation is always the victim
+            REQUIRE(x.target == live.back());
+            live.pop_back();
+        }
+    }
+
+    config.pattern = ProducerConsumer;
+    WorkloadGenerator fifo(config);
+    size_t oldest = 0;
+    for (int i = 0; i < config.ops; i++) {
+        WorkloadOp op = fifo.next();
+        if (!op.alloc) REQUIRE(op.target == oldest++);
+    }
+}
+
+TEST_CASE("Heap snapshot round-trips through an mmap'd image", "[snapshot]") {
+    initialize_memory();
+    set_strategy(BestFit);
+    int a = allocate(100);
+    int b = allocate(200);
+    int c = allocate(50);
+    REQUIRE(free_block(b));
+
+    const string path = "test_snapshot.heap";
+    REQUIRE(save_heap(path));
+
+    {
+        HeapImage image;
+        REQUIRE(image.open(path));
+        REQUIRE(image.header().block_count == memory.size());
+        const SnapshotBlock* blk = image.find(c);
+        REQUIRE(blk != nullptr);
+        REQUIRE(blk->start == 300);
+        REQUIRE(blk->size == 50);
+        REQUIRE(image.find(b) == nullptr);
+    }
+
+    vector<Block> before = memory;
+    initialize_memory();
+    set_strategy(FirstFit);
+    REQUIRE(load_heap(path));
+
+    REQUIRE(current_strategy == BestFit);
+    REQUIRE(memory.size() == before.size());
+    for (size_t i = 0; i < memory.size(); ++i) {
+        REQUIRE(memory[i].start == before[i].start);
+        REQUIRE(memory[i].size == before[i].size);
+        REQUIRE(memory[i].used == before[i].used);
+        REQUIRE(memory[i].id == before[i].id);
+    }
+    REQUIRE(allocate(10) == c + 1);   // id counter restored
+    REQUIRE(free_block(a));
+
+    // loading drops the previous heap's side structures
+    REQUIRE(arena_create(64) > 0);
+    Handle hd = allocate_handle(32);
+    REQUIRE(load_heap(path));
+    REQUIRE(get_arena_stats(0).arenas == 0);
+    REQUIRE_FALSE(handle_valid(hd));
+
+    // a used block whose id is shared or was never issued is rejected
+    auto patch_id = [&](size_t index, auto id_for) {
+        FILE* f = fopen(path.c_str(), "r+b");
+        REQUIRE(f != nullptr);
+        SnapshotHeader h;
+        REQUIRE(fread(&h, sizeof(h), 1, f) == 1);
+        SnapshotBlock blk;
+        fseek(f, h.blocks_offset + index * sizeof(blk), SEEK_SET);
+        REQUIRE(fread(&blk, sizeof(blk), 1, f) == 1);
+        REQUIRE(blk.used == 1);
+        blk.id = id_for(h);
+        fseek(f, h.blocks_offset + index * sizeof(blk), SEEK_SET);
+        REQUIRE(fwrite(&blk, sizeof(blk), 1, f) == 1);
+        fclose(f);
+    };
+    patch_id(2, [&](const SnapshotHeader&) { return a; });   // c's block takes a's id
+    REQUIRE_FALSE(load_heap(path));
+    REQUIRE(save_heap(path));
+    patch_id(2, [](const SnapshotHeader& h) { return (int)h.next_id; });
+    REQUIRE_FALSE(load_heap(path));
+    REQUIRE(save_heap(path));
+    REQUIRE(load_heap(path));
+
+    // images whose blocks do not tile the heap are rejected
+    {
+        FILE* f = fopen(path.c_str(), "r+b");
+        REQUIRE(f != nullptr);
+        SnapshotHeader h;
+        REQUIRE(fread(&h, sizeof(h), 1, f) == 1);
+        SnapshotBlock blk;
+        fseek(f, h.blocks_offset, SEEK_SET);
+        REQUIRE(fread(&blk, sizeof(blk), 1, f) == 1);
+        blk.size += 1 << 20;   // would run past the heap
+        fseek(f, h.blocks_offset, SEEK_SET);
+        REQUIRE(fwrite(&blk, sizeof(blk), 1, f) == 1);
+        fclose(f);
+    }
+    REQUIRE_FALSE(load_heap(path));
+    REQUIRE(memory.size() == before.size());   // a failed load changes nothing
+    {
+        // a block count whose byte size wraps around
+        FILE* f = fopen(path.c_str(), "r+b");
+        REQUIRE(f != nullptr);
+        SnapshotHeader h;
+        REQUIRE(fread(&h, sizeof(h), 1, f) == 1);
+        h.block_count = UINT64_MAX / sizeof(SnapshotBlock) + 2;
+        fseek(f, 0, SEEK_SET);
+        REQUIRE(fwrite(&h, sizeof(h), 1, f) == 1);
+        fclose(f);
+    }
+    HeapImage bad;
+    REQUIRE_FALSE(bad.open(path));
+
+    remove(path.c_str());
+    REQUIRE_FALSE(load_heap(path));
+}
+
+TEST_CASE("Batch line reader handles chunk boundaries", "[batch]") {
+    const string path = "test_script.txt";
+    string script;
+    for (int i = 0; i < 200; i++) script += "alloc " + to_string(i) + "\r\n";
+    script += "  free   12  \n";
+    script += string(5000, 'x') + "\n";   // spans many refills and buffer growth
+    script += "exit";                      // no trailing newline
+    FILE* f = fopen(path.c_str(), "wb");
+    fwrite(script.data(), 1, script.size(), f);
+    fclose(f);
+
+    int fd = open(path.c_str(), O_RDONLY);
+    REQUIRE(fd >= 0);
+    LineReader reader(fd, 16);   // tiny chunks force refills mid-line
+    string_view line;
+    string_view args[4];
+    for (int i = 0; i < 200; i++) {
+        REQUIRE(reader.next_line(line));
+        REQUIRE(split_tokens(line, args, 4) == 2);
+        REQUIRE(args[0] == "alloc");
+        size_t sz;
+        REQUIRE(parse_size(args[1], sz));
+        REQUIRE(sz == (size_t)i);
+    }
+    REQUIRE(reader.next_line(line));
+    REQUIRE(split_tokens(line, args, 4) == 2);
+    REQUIRE(args[1] == "12");
+    REQUIRE(reader.next_line(line));
+    REQUIRE(line == string(5000, 'x'));
+    REQUIRE(reader.next_line(line));
+    REQUIRE(line == "exit");
+    REQUIRE_FALSE(reader.next_line(line));
+    close(fd);
+    remove(path.c_str());
+
+    size_t sz;
+    int id;
+    REQUIRE_FALSE(parse_size("12x", sz));
+    REQUIRE_FALSE(parse_size("-3", sz));
+    REQUIRE(parse_int("-3", id));
+}
+
+TEST_CASE("Socket server answers batched requests", "[server]") {
+    initialize_memory();
+    set_strategy(FirstFit);
+
+    const string path = "test_allocator.sock";
+    AllocatorServer server;
+    REQUIRE(server.listen(path));
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    REQUIRE(connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0);
+
+    // one message: alloc 100, alloc 2000 (fails), free id 1, stats, bogus op
+    vector<WireOp> ops = {
+        {OpAlloc, 0, 100}, {OpAlloc, 0, 2000},
+        {OpFree, 0, (1ull << 32) + 1},   // would truncate to id 1
+        {OpFree, 0, 1}, {OpStats, 0, 0}, {99, 0, 0}
+    };
+    uint32_t count = ops.size();
+    REQUIRE(write(fd, &count, sizeof(count)) == sizeof(count));
+    REQUIRE(write(fd, ops.data(), ops.size() * sizeof(WireOp)) == (ssize_t)(ops.size() * sizeof(WireOp)));
+
+    for (int i = 0; i < 4; i++) server.poll_once(50);
+    REQUIRE(server.client_count() == 1);
+
+    uint32_t words = 0;
+    REQUIRE(read(fd, &words, sizeof(words)) == sizeof(words));
+    REQUIRE(words == 5 + STATS_WORDS);
+    vector<int64_t> result(words);
+    REQUIRE(read(fd, result.data(), words * sizeof(int64_t)) == (ssize_t)(words * sizeof(int64_t)));
+    REQUIRE(result[0] == 1);
+    REQUIRE(result[1] == -1);
+    REQUIRE(result[2] == -1);
+    REQUIRE(result[3] == 1);
+    REQUIRE(result[4] == (int64_t)MEMORY_SIZE);   // total_free after the free
+    REQUIRE(result[6] == 1);                     // one fragment
+    REQUIRE(result[7] == 0);                     // no used blocks
+    REQUIRE(result[8] == -1);
+
+    close(fd);
+    server.poll_once(50);
+    REQUIRE(server.client_count() == 0);
+
+    // a full batch of stats (2 MiB of replies) outgrows the socket buffer;
+    // after a half-close the client must still receive all of it
+    auto connect_nonblocking = [&]() {
+        int s = socket(AF_UNIX, SOCK_STREAM, 0);
+        REQUIRE(connect(s, (sockaddr*)&addr, sizeof(addr)) == 0);
+        fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+        return s;
+    };
+    vector<char> batch(sizeof(uint32_t) + MAX_OPS_PER_MESSAGE * sizeof(WireOp));
+    uint32_t full = MAX_OPS_PER_MESSAGE;
+    memcpy(batch.data(), &full, sizeof(full));
+    for (uint32_t i = 0; i < full; ++i) {
+        WireOp op{OpStats, 0, 0};
+        memcpy(batch.data() + sizeof(uint32_t) + i * sizeof(WireOp), &op, sizeof(op));
+    }
+    const size_t reply_size = sizeof(uint32_t) + (size_t)full * STATS_WORDS * sizeof(int64_t);
+
+    fd = connect_nonblocking();
+    size_t sent = 0, received = 0;
+    vector<char> sink(1 << 16);
+    for (int round = 0; round < 10000 && received < reply_size; ++round) {
+        if (sent < batch.size()) {
+            ssize_t n = write(fd, batch.data() + sent, batch.size() - sent);
+            if (n > 0) sent += n;
+            if (sent == batch.size()) shutdown(fd, SHUT_WR);
+        }
+        server.poll_once(1);
+        ssize_t n = read(fd, sink.data(), sink.size());
+        if (n > 0) received += n;
+    }
+    REQUIRE(received == reply_size);
+    for (int i = 0; i < 10 && server.client_count() > 0; ++i) server.poll_once(10);
+    REQUIRE(server.client_count() == 0);   // dropped once everything was sent
+    REQUIRE(read(fd, sink.data(), sink.size()) == 0);
+    close(fd);
+
+    // a client that sends without ever reading stops being read: buffered
+    // requests and replies stay bounded instead of growing with the stream
+    fd = connect_nonblocking();
+    sent = 0;
+    for (int round = 0; round < 400; ++round) {
+        ssize_t n = write(fd, batch.data() + sent % batch.size(),
+                          batch.size() - sent % batch.size());
+        if (n > 0) sent += n;
+        server.poll_once(0);
+    }
+    REQUIRE(server.buffered_bytes() < 8u << 20);
+    REQUIRE(sent < 16 * batch.size());      // the client felt the backpressure
+    close(fd);
+    for (int i = 0; i < 10 && server.client_count() > 0; ++i) server.poll_once(10);
+    REQUIRE(server.client_count() == 0);
+    server.close();
+}
+
+TEST_CASE("Shared-memory heap is usable across processes", "[shm]") {
+    const string name = "/mra_test_" + to_string(getpid());
+    SharedHeap heap;
+    REQUIRE(heap.create(name, 4096, 64));
+    SharedHeap second;
+    REQUIRE_FALSE(second.create(name, 4096, 64));   // never truncates a live segment
+
+    uint64_t a = heap.allocate(100);
+    REQUIRE(a != SHM_NULL);
+    REQUIRE(a % 16 == 0);
+    REQUIRE(heap.allocate(SIZE_MAX - 3) == SHM_NULL);   // would round to 0 bytes
+    REQUIRE(heap.allocate(4097) == SHM_NULL);
+    strcpy((char*)heap.at(a), "from parent");
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // child maps the segment independently and hands back a buffer by offset
+        SharedHeap child;
+        bool ok = child.attach(name) && strcmp((char*)child.at(a), "from parent") == 0;
+        uint64_t b = ok ? child.allocate(200) : SHM_NULL;
+        if (b != SHM_NULL) strcpy((char*)child.at(b), "from child");
+        ok = ok && child.free(a);
+        _exit(ok && b != SHM_NULL ? 0 : 1);
+    }
+    int status = 0;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+
+    ShmStats stats = heap.stats();
+    REQUIRE(stats.used_blocks == 1);
+    REQUIRE(stats.fragments == 2);   // hole left by the child's free + tail
+    REQUIRE_FALSE(heap.free(a));     // already freed by the child
+
+    uint64_t b = 112;                // 100 rounded up to 16, right after block a
+    REQUIRE(strcmp((char*)heap.at(a + b), "from child") == 0);
+    REQUIRE(heap.free(a + b));
+    stats = heap.stats();
+    REQUIRE(stats.used_blocks == 0);
+    REQUIRE(stats.fragments == 1);   // fully coalesced
+    REQUIRE(stats.total_free == 4096);
+
+    heap.detach();
+    REQUIRE(SharedHeap::destroy(name));
+
+    // two records: one used block and the free tail; the table is then full
+    REQUIRE(heap.create(name, 4096, 2));
+    uint64_t x = heap.allocate(16);
+    REQUIRE(x != SHM_NULL);
+    REQUIRE(heap.allocate(16) == SHM_NULL);         // tail cannot be split
+    REQUIRE(heap.allocate(4096 - 16) != SHM_NULL);  // exact fit needs no record
+    heap.detach();
+    REQUIRE(SharedHeap::destroy(name));
+}
+
+TEST_CASE("Hybrid strategy serves small requests from slabs", "[hybrid]") {
+    initialize_memory();
+    set_strategy(Hybrid);
+    REQUIRE(set_small_threshold(64));
+    REQUIRE(get_size_classes().back() == 64);
+
+    // 20-byte requests round to the 24-byte class; 5 per 120-byte slab
+    vector<int> small;
+    for (int i = 0; i < 6; i++) {
+        int id = allocate(20);
+        REQUIRE(id != -1);
+        small.push_back(id);
+    }
+    int large = allocate(300);
+    REQUIRE(large != -1);
+
+    HybridStats stats = get_hybrid_stats();
+    REQUIRE(stats.slabs == 2);
+    REQUIRE(stats.slab_bytes == 240);
+    REQUIRE(stats.live_objects == 6);
+    REQUIRE(stats.requested_bytes == 120);
+    REQUIRE(stats.class_bytes == 144);
+    REQUIRE(stats.free_slots == 4);
+    REQUIRE(stats.large_blocks == 1);
+    REQUIRE(stats.large_bytes == 300);
+    REQUIRE(memory[2].start == 240);      // large block after both slabs
+    REQUIRE_FALSE(set_small_threshold(128));
+
+    for (int id : small) REQUIRE(free_block(id));
+    REQUIRE_FALSE(free_block(small[0]));
+    REQUIRE(free_block(large));
+
+    // empty slabs are returned and coalesced
+    REQUIRE(get_hybrid_stats().slabs == 0);
+    REQUIRE(memory.size() == 1);
+    REQUIRE(memory[0].size == MEMORY_SIZE);
+
+    // a slab of the largest class must fit twice in the heap
+    REQUIRE(max_small_threshold() == MEMORY_SIZE / 2);
+    REQUIRE_FALSE(set_small_threshold(100000000000));
+    REQUIRE_FALSE(set_small_threshold(MEMORY_SIZE / 2 + 1));
+    REQUIRE_FALSE(set_size_classes({16, MEMORY_SIZE}));
+    REQUIRE(get_size_classes().back() == 64);   // unchanged
+    REQUIRE(set_small_threshold(MEMORY_SIZE / 2));
+    REQUIRE(set_small_threshold(64));
+    set_strategy(FirstFit);
+}
+
+TEST_CASE("Huge requests use the dedicated top region", "[huge]") {
+    initialize_memory();
+    set_strategy(FirstFit);
+    REQUIRE(set_huge_region(256, 512));
+
+    // general heap shrinks to [0, 512); region spans [512, 1024)
+    size_t sum = 0;
+    for (const auto& block : memory) sum += block.size;
+    REQUIRE(sum == MEMORY_SIZE - 512);
+
+    int small = allocate(100);
+    int big1 = allocate(300);   // 5 pages
+    int big2 = allocate(200);   // below threshold: general heap
+    REQUIRE(small != -1);
+    REQUIRE(big1 != -1);
+    REQUIRE(big2 != -1);
+    REQUIRE(allocate(300) == -1);   // only 3 pages left in the region
+
+    HugeStats stats = get_huge_stats();
+    REQUIRE(stats.used_spans == 1);
+    REQUIRE(stats.used_bytes == 5 * SIM_PAGE_SIZE);
+    REQUIRE(stats.free_bytes == 3 * SIM_PAGE_SIZE);
+    REQUIRE(stats.failures == 1);
+    REQUIRE(memory.size() == 3);    // small, big2, free tail: nothing huge in the list
+
+    REQUIRE_FALSE(set_huge_region(0, 0));   // live span
+    REQUIRE(free_block(big1));
+    REQUIRE(get_huge_stats().largest_free == 512);
+
+    REQUIRE(free_block(small));
+    REQUIRE(free_block(big2));
+    REQUIRE(set_huge_region(0, 0));
+    REQUIRE(memory.size() == 1);
+    REQUIRE(memory[0].size == MEMORY_SIZE);
+}
+
+TEST_CASE("Page residency tracks dirty pages and purges them", "[residency]") {
+    initialize_memory();
+    set_strategy(FirstFit);
+    set_purge_policy(PurgeNone);
+
+    REQUIRE(get_residency_stats().rss_bytes == 0);   // nothing touched yet
+    int a = allocate(100);   // pages 0-1
+    int b = allocate(100);   // pages 1-3 (page 1 shared)
+    REQUIRE(page_state(1) == PageInUse);
+    REQUIRE(get_residency_stats().rss_bytes == 4 * SIM_PAGE_SIZE);
+
+    REQUIRE(free_block(a));
+    REQUIRE(page_state(0) == PageDirty);
+    REQUIRE(page_state(1) == PageInUse);   // still overlapped by b
+    REQUIRE(page_state(5) == PageClean);
+
+    REQUIRE(purge_free_pages() == 1);
+    REQUIRE(page_state(0) == PagePurged);
+    REQUIRE(get_residency_stats().rss_bytes == 3 * SIM_PAGE_SIZE);
+
+    // decay: dirty pages are purged once they stay dirty for 2 operations
+    set_purge_policy(PurgeDecay, 2);
+    REQUIRE(free_block(b));
+    REQUIRE(get_residency_stats().dirty == 3);
+    int c = allocate(500);   // tick 1: pages 0-7 in use again
+    REQUIRE(get_residency_stats().dirty == 0);
+    REQUIRE(free_block(c));  // tick 2: 8 dirty pages
+    allocate(1);             // tick 3: page 0 in use
+    REQUIRE(get_residency_stats().dirty == 7);
+    allocate(1);             // tick 4: decay purges the seven still-free pages
+    REQUIRE(get_residency_stats().dirty == 0);
+    REQUIRE(page_state(7) == PagePurged);
+
+    // pages dirtied under PurgeNone are not queued, but start decaying once
+    // the policy switches to decay
+    initialize_memory();
+    set_purge_policy(PurgeNone);
+    REQUIRE(free_block(allocate(200)));
+    REQUIRE(get_residency_stats().dirty == 4);
+    set_purge_policy(PurgeDecay, 2);
+    REQUIRE_FALSE(free_block(9999));   // an operation, so time advances
+    REQUIRE(get_residency_stats().dirty == 4);
+    REQUIRE_FALSE(free_block(9999));
+    REQUIRE(get_residency_stats().dirty == 0);
+
+    set_purge_policy(PurgeNone);
+}
+
+TEST_CASE("Heap grows on demand and trims its free tail", "[growth]") {
+    initialize_memory();
+    set_strategy(FirstFit);
+    set_heap_growth(512, 4096);
+
+    int a = allocate(1000);
+    int b = allocate(300);     // needs growth: tail 24 free + 512 chunk
+    REQUIRE(a != -1);
+    REQUIRE(b != -1);
+    HeapStats stats = get_heap_stats();
+    REQUIRE(stats.footprint == MEMORY_SIZE + 512);
+    REQUIRE(stats.grow_count == 1);
+
+    int c = allocate(2000);    // larger than a chunk: grows by the shortfall
+    REQUIRE(c != -1);
+    REQUIRE(heap_size <= 4096);
+    REQUIRE(allocate(4096) == -1);   // would exceed the limit
+
+    size_t sum = 0;
+    for (const auto& block : memory) sum += block.size;
+    REQUIRE(sum == heap_size);
+
+    REQUIRE(free_block(c));
+    REQUIRE(free_block(b));
+    size_t trimmed = trim_heap();
+    REQUIRE(trimmed > 0);
+    REQUIRE(heap_size == MEMORY_SIZE);   // never below the initial heap
+    REQUIRE(get_heap_stats().trim_count == 1);
+    REQUIRE(trim_heap() == 0);
+
+    // automatic trim once the free tail reaches the threshold
+    set_heap_growth(256, 0, 256);
+    int d = allocate(400);
+    REQUIRE(heap_size > MEMORY_SIZE);
+    REQUIRE(free_block(d));
+    REQUIRE(heap_size == MEMORY_SIZE);
+
+    set_heap_growth(0);
+    REQUIRE(free_block(a));
+    REQUIRE(memory.size() == 1);
+}
+
+TEST_CASE("Indexed Best/Worst-Fit match a linear scan", "[free-index]") {
+    for (AllocationStrategy strat : {BestFit, WorstFit}) {
+        initialize_memory();
+        set_strategy(strat);
+        Xoshiro256 rng(strat);
+        vector<int> live;
+
+        for (int step = 0; step < 2000; step++) {
+            if (!live.empty() && rng.below(2) == 0) {
+                size_t idx = rng.below(live.size());
+                REQUIRE(free_block(live[idx]));
+                live[idx] = live.back();
+                live.pop_back();
+                continue;
+            }
+
+            size_t size = 1 + rng.below(120);
+            // reference pick: the original full scan
+            int expected = -1;
+            size_t chosen = strat == BestFit ? SIZE_MAX : 0;
+            for (size_t i = 0; i < memory.size(); ++i) {
+                if (memory[i].used || memory[i].size < size) continue;
+                if ((strat == BestFit && memory[i].size < chosen) ||
+                    (strat == WorstFit && memory[i].size > chosen)) {
+                    chosen = memory[i].size;
+                    expected = memory[i].start;
+                }
+            }
+
+            int id = allocate(size);
+            REQUIRE((id == -1) == (expected == -1));
+            if (id == -1) continue;
+            live.push_back(id);
+            for (const auto& block : memory)
+                if (block.id == id) REQUIRE((int)block.start == expected);
+        }
+    }
+    set_strategy(FirstFit);
+}
+
+TEST_CASE("BlockTree matches an ordered map under split/merge churn", "[block-tree]") {
+    const size_t heap = 1 << 20;
+    BlockTree tree;
+    map<size_t, size_t> ref;   // start -> size
+    tree.insert(Block(0, heap, false, 0));
+    ref[0] = heap;
+    Xoshiro256 rng(7);
+
+    for (int step = 0; step < 40000; step++) {
+        size_t addr = rng.below(heap);
+        auto it = tree.containing(addr);
+        REQUIRE(it != tree.end());
+        auto r = prev(ref.upper_bound(addr));
+        REQUIRE(it->start == r->first);
+        REQUIRE(it->size == r->second);
+
+        // split-biased early so the tree grows several levels, then drains
+        bool split = step < 25000 ? rng.below(4) != 0 : rng.below(4) == 0;
+        if (split && it->size >= 2) {
+            size_t first = 1 + rng.below(it->size - 1);
+            it = tree.split(it, first);
+            ref[r->first + first] = r->second - first;
+            r->second = first;
+            REQUIRE(it->size == first);
+        } else if (!split && next(r) != ref.end()) {
+            it = tree.merge_next(it);
+            r->second += next(r)->second;
+            ref.erase(next(r));
+            REQUIRE(it->size == r->second);
+        }
+    }
+
+    REQUIRE(tree.size() == ref.size());
+    auto r = ref.begin();
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++r) {
+        REQUIRE(it->start == r->first);
+        REQUIRE(it->size == r->second);
+    }
+    auto last = tree.end();
+    --last;
+    REQUIRE(last->start == ref.rbegin()->first);
+
+    // erase everything and the tree collapses back to a single leaf
+    for (const auto& entry : ref) REQUIRE(tree.erase(entry.first));
+    REQUIRE(tree.empty());
+    REQUIRE(tree.height() == 1);
+    REQUIRE(tree.begin() == tree.end());
+}
+
+TEST_CASE("Compact metadata round-trips granule-aligned blocks", "[compact]") {
+    REQUIRE(sizeof(CompactBlock) == 12);
+    REQUIRE_FALSE(set_granule(12));
+    REQUIRE_FALSE(set_granule(2 * SIM_PAGE_SIZE));
+    REQUIRE(set_granule(16));
+    initialize_memory();
+    set_strategy(FirstFit);
+
+    int a = allocate(10);      // rounded to 16
+    int b = allocate(100);     // rounded to 112
+    int c = allocate(33);      // rounded to 48
+    REQUIRE(free_block(b));
+    REQUIRE(memory[0].size == 16);
+    REQUIRE(memory[2].start == 128);
+
+    vector<CompactBlock> packed;
+    REQUIRE(pack_blocks(packed));
+    REQUIRE(packed.size() == memory.size());
+    REQUIRE(packed[0].start == 0);
+    REQUIRE(packed[0].granules() == 1);
+    REQUIRE(packed[0].used());
+    REQUIRE_FALSE(packed[1].used());
+    REQUIRE(packed[2].id == c);
+
+    vector<Block> before = memory;
+    unpack_blocks(packed);
+    REQUIRE(memory.size() == before.size());
+    for (size_t i = 0; i < memory.size(); ++i) {
+        REQUIRE(memory[i].start == before[i].start);
+        REQUIRE(memory[i].size == before[i].size);
+        REQUIRE(memory[i].used == before[i].used);
+        REQUIRE(memory[i].id == before[i].id);
+    }
+
+    MetadataStats stats = get_metadata_stats();
+    REQUIRE(stats.live_allocs == 2);
+    REQUIRE(stats.block_bytes == memory.size() * sizeof(Block));
+    REQUIRE(stats.compact_bytes == memory.size() * 12);
+    REQUIRE(stats.compact_per_alloc < stats.per_alloc);
+    REQUIRE(free_block(a));
+
+    // byte-exact sizes cannot be packed at a coarser granule
+    REQUIRE(set_granule(1));
+    REQUIRE(allocate(7) != -1);
+    REQUIRE(set_granule(16));
+    REQUIRE_FALSE(pack_blocks(packed));
+    REQUIRE(get_metadata_stats().compact_bytes == 0);
+    REQUIRE(set_granule(1));
+}
+
+TEST_CASE("TaggedHeap coalesces through in-band boundary tags", "[tagged]") {
+    TaggedHeap heap(4096);
+    REQUIRE(heap.check());
+    TagStats empty = heap.stats();
+    REQUIRE(empty.fragments == 1);
+
+    size_t a = heap.allocate(40);
+    size_t b = heap.allocate(100);
+    size_t c = heap.allocate(1);
+    REQUIRE(a != TAG_NULL);
+    REQUIRE(a % TaggedHeap::ALIGN == 0);
+    REQUIRE(b == a + heap.block_size(a));
+    REQUIRE(heap.block_size(c) == TaggedHeap::MIN_BLOCK);
+    REQUIRE(heap.allocate(SIZE_MAX) == TAG_NULL);        // must not round to a tiny block
+    REQUIRE(heap.allocate(SIZE_MAX - 20) == TAG_NULL);
+    memset(heap.at(b), 0xAB, 100);   // payload writes leave the tags intact
+    REQUIRE(heap.check());
+
+    REQUIRE(heap.free(a));
+    REQUIRE_FALSE(heap.free(a));      // double free
+    REQUIRE_FALSE(heap.free(b + 8));  // not a payload
+    REQUIRE(heap.free(c));            // merges with the tail
+    REQUIRE(heap.stats().fragments == 2);
+    REQUIRE(heap.free(b));            // merges both ways
+    REQUIRE(heap.check());
+    TagStats s = heap.stats();
+    REQUIRE(s.fragments == 1);
+    REQUIRE(s.total_free == empty.total_free);
+
+    // random churn keeps the tags and the free list consistent
+    Xoshiro256 rng(3);
+    vector<size_t> live;
+    for (int step = 0; step < 5000; step++) {
+        if (!live.empty() && rng.below(2) == 0) {
+            size_t idx = rng.below(live.size());
+            REQUIRE(heap.free(live[idx]));
+            live[idx] = live.back();
+            live.pop_back();
+        } else {
+            size_t off = heap.allocate(1 + rng.below(200));
+            if (off != TAG_NULL) live.push_back(off);
+        }
+    }
+    REQUIRE(heap.check());
+    for (size_t off : live) REQUIRE(heap.free(off));
+    REQUIRE(heap.stats().total_free == empty.total_free);
+
+    TaggedHeap tiny(16);
+    REQUIRE(tiny.allocate(1) == TAG_NULL);
+    REQUIRE(tiny.check());
+}
+
+TEST_CASE("Bitmap strategy matches first-fit on granule-rounded sizes", "[bitmap]") {
+    auto run = [](AllocationStrategy strat) {
+        initialize_memory();
+        set_strategy(strat);
+        Xoshiro256 rng(11);
+        vector<int> live;
+        for (int step = 0; step < 3000; step++) {
+            if (!live.empty() && rng.below(2) == 0) {
+                size_t idx = rng.below(live.size());
+                REQUIRE(free_block(live[idx]));
+                live[idx] = live.back();
+                live.pop_back();
+                continue;
+            }
+            size_t size = 1 + rng.below(100);
+            if (strat == FirstFit) size = (size + BITMAP_GRANULE - 1) / BITMAP_GRANULE * BITMAP_GRANULE;
+            int id = allocate(size);
+            if (id != -1) live.push_back(id);
+        }
+        return memory;
+    };
+    vector<Block> bitmap = run(Bitmap);
+    vector<Block> first = run(FirstFit);
+    REQUIRE(bitmap.size() == first.size());
+    for (size_t i = 0; i < first.size(); ++i) {
+        REQUIRE(bitmap[i].start == first[i].start);
+        REQUIRE(bitmap[i].size == first[i].size);
+        REQUIRE(bitmap[i].id == first[i].id);
+    }
+
+    // switching over an unaligned layout: the partly used granule is skipped
+    initialize_memory();
+    set_strategy(FirstFit);
+    int a = allocate(7);
+    set_strategy(Bitmap);
+    int b = allocate(10);
+    REQUIRE(memory.size() == 4);
+    REQUIRE(memory[1].start == 7);
+    REQUIRE_FALSE(memory[1].used);
+    REQUIRE(memory[2].start == BITMAP_GRANULE);
+    REQUIRE(memory[2].size == BITMAP_GRANULE);
+    REQUIRE(memory[2].id == b);
+    REQUIRE(free_block(a));
+    REQUIRE(free_block(b));
+    REQUIRE(memory.size() == 1);
+    REQUIRE(allocate(MEMORY_SIZE) != -1);   // the whole heap is one run again
+
+    // Buddy leaves [384,512) and [512,1024) as separate free blocks; the map
+    // sees one run there, which must become one block before it is placed
+    for (AllocationStrategy via : {Buddy, Stack}) {
+        initialize_memory();
+        set_strategy(Buddy);
+        allocate(100);
+        int mid = allocate(100);
+        allocate(100);
+        REQUIRE(free_block(mid));
+        set_strategy(via);
+        set_strategy(Bitmap);
+        size_t at = SIZE_MAX;
+        REQUIRE(allocate(200, at) != -1);
+        REQUIRE(at == 384);
+        size_t end = 0;
+        for (const auto& block : memory) {
+            REQUIRE(block.start == end);
+            REQUIRE(block.size > 0);
+            REQUIRE(block.size <= MEMORY_SIZE - end);   // a wrapped size tiles too
+            end += block.size;
+        }
+        REQUIRE(end == MEMORY_SIZE);
+    }
+    set_strategy(FirstFit);
+}
+
+TEST_CASE("free_at and sized free locate blocks without an id scan", "[free-at]") {
+    initialize_memory();
+    set_strategy(FirstFit);
+    size_t off_a = SIZE_MAX, off_b = SIZE_MAX, off_c = SIZE_MAX;
+    allocate(100, off_a);
+    allocate(50, off_b);
+    int c = allocate(30, off_c);
+    REQUIRE(off_a == 0);
+    REQUIRE(off_b == 100);
+    REQUIRE(off_c == 150);
+
+    REQUIRE_FALSE(free_at(off_b + 1));        // inside a block, not its start
+    REQUIRE_FALSE(free_at(off_b, 51));        // larger than the allocation
+    REQUIRE(free_at(off_b, 50));
+    REQUIRE_FALSE(free_at(off_b));            // already free
+    REQUIRE_FALSE(free_block(c, 31));         // larger than the allocation
+    REQUIRE(free_block(c, 30));
+    REQUIRE_FALSE(free_block(c, 30));
+    REQUIRE(free_at(off_a));
+    REQUIRE(memory.size() == 1);
+
+    // small objects are found through their slab, huge ones through the spans
+    initialize_memory();
+    set_strategy(Hybrid);
+    REQUIRE(set_huge_region(256, 512));
+    size_t s1, s2, h, big;
+    int id1 = allocate(20, s1);
+    int id2 = allocate(20, s2);
+    REQUIRE(allocate(300, h) != -1);
+    int id_big = allocate(100, big);
+    REQUIRE(id1 != -1);
+    REQUIRE(s2 == s1 + 24);                   // adjacent slots of the 24-byte class
+    REQUIRE(h >= get_huge_stats().region_start);
+
+    REQUIRE_FALSE(free_at(s1 + 4));           // not on a slot boundary
+    REQUIRE(free_at(s2, 20));
+    REQUIRE_FALSE(free_block(id2));           // gone from the id map too
+    REQUIRE_FALSE(free_block(id1, 25));       // beyond its 24-byte slot
+    REQUIRE(free_block(id1, 20));
+    REQUIRE(get_hybrid_stats().slabs == 0);
+    REQUIRE(free_at(h, 300));
+    REQUIRE(get_huge_stats().used_spans == 0);
+    REQUIRE(free_block(id_big, 100));
+    REQUIRE(memory.size() == 1);
+
+    REQUIRE(set_huge_region(0, 0));
+    set_strategy(FirstFit);
+}
+
+TEST_CASE("Handles recycle slots and reject stale frees", "[handles]") {
+    initialize_memory();
+    set_strategy(FirstFit);
+    size_t base_slots = handle_slots();
+
+    Handle a = allocate_handle(100);
+    Handle b = allocate_handle(100);
+    REQUIRE(a != NULL_HANDLE);
+    REQUIRE(b != NULL_HANDLE);
+    REQUIRE(a != b);
+    REQUIRE(handle_valid(a));
+    REQUIRE(handle_offset(b) == 100);
+    REQUIRE(handle_id(a) > 0);
+
+    REQUIRE(free_handle(a));
+    REQUIRE_FALSE(handle_valid(a));
+    REQUIRE_FALSE(free_handle(a));             // double free
+    Handle c = allocate_handle(50);            // reuses a's slot and address
+    REQUIRE((c & 0xFFFFFFFF) == (a & 0xFFFFFFFF));
+    REQUIRE(handle_offset(c) == 0);
+    REQUIRE_FALSE(free_handle(a));             // stale handle cannot free c
+    REQUIRE(handle_valid(c));
+
+    // freeing by id behind the handle's back leaves the handle unusable
+    REQUIRE(free_block(handle_id(b)));
+    REQUIRE_FALSE(handle_valid(b));
+    REQUIRE_FALSE(free_handle(b));
+    REQUIRE(free_handle(c));
+
+    // churn: the table stays as large as the peak live count
+    Xoshiro256 rng(5);
+    vector<Handle> live;
+    size_t peak = 0;
+    for (int step = 0; step < 5000; step++) {
+        if (!live.empty() && rng.below(2) == 0) {
+            size_t idx = rng.below(live.size());
+            REQUIRE(free_handle(live[idx]));
+            live[idx] = live.back();
+            live.pop_back();
+        } else {
+            Handle h = allocate_handle(1 + rng.below(40));
+            if (h != NULL_HANDLE) live.push_back(h);
+        }
+        peak = max(peak, live.size());
+    }
+    REQUIRE(handle_slots() <= max(peak, base_slots + 2));
+
+    // handles from before a reset stay stale
+    initialize_memory();
+    for (Handle h : live) REQUIRE_FALSE(handle_valid(h));
+
+    // freed ids are reissued, so churn far past INT_MAX cycles through a
+    // handful of ids instead of running next_id up
+    set_strategy(FirstFit);
+    Handle first = allocate_handle(16);
+    REQUIRE(first != NULL_HANDLE);
+    for (int i = 0; i < 100000; ++i) {
+        Handle h = allocate_handle(8 + i % 32);
+        REQUIRE(h != NULL_HANDLE);
+        REQUIRE(free_handle(h));
+        REQUIRE_FALSE(free_handle(h));
+    }
+    REQUIRE(next_id <= 3);
+    for (int i = 0; i < 100000; ++i) REQUIRE(free_block(allocate(8)));
+    REQUIRE(next_id <= 3);
+
+    // ids never wrap onto live ones: with none free at INT_MAX allocation
+    // fails, and a free makes that id available again
+    next_id = INT_MAX - 1;
+    Handle last = allocate_handle(16);
+    REQUIRE(last != NULL_HANDLE);
+    while (allocate(1) != -1) {}              // drain the recycled ids
+    REQUIRE(allocate_handle(16) == NULL_HANDLE);
+    REQUIRE(get_heap_stats().total_free > 16);   // out of ids, not space
+    REQUIRE(next_id == INT_MAX);
+    int first_id = handle_id(first);
+    REQUIRE(free_handle(first));
+    Handle again = allocate_handle(16);
+    REQUIRE(again != NULL_HANDLE);
+    REQUIRE(handle_id(again) == first_id);
+    REQUIRE_FALSE(handle_valid(first));       // same id, new generation
+    initialize_memory();
+    REQUIRE(allocate(16) == 1);
+    initialize_memory();
+}
+
+TEST_CASE("Arenas bump-allocate, roll back scopes and reset in O(1)", "[arena]") {
+    initialize_memory();
+    set_strategy(FirstFit);
+    int before = memory.size();
+
+    int a = arena_create(256);
+    REQUIRE(a > 0);
+    REQUIRE(memory.size() == (size_t)before + 1);
+    size_t base = memory[0].start;
+
+    size_t p1 = arena_alloc(a, 10);
+    size_t p2 = arena_alloc(a, 8, 16);
+    REQUIRE(p1 == base);
+    REQUIRE(p2 == base + 16);                  // 6 bytes of padding
+    REQUIRE(arena_push_scope(a));
+    REQUIRE(arena_alloc(a, 100) == base + 24);
+    REQUIRE(arena_alloc(a, 200) == SIZE_MAX);  // does not fit
+    REQUIRE(arena_alloc(a, SIZE_MAX - 8) == SIZE_MAX);  // must not wrap
+    REQUIRE(arena_alloc(a, 8, (size_t)1 << 62) == SIZE_MAX);
+    ArenaStats s = get_arena_stats(a);
+    REQUIRE(s.used == 124);
+    REQUIRE(s.padding == 6);
+    REQUIRE(s.waste == 256 - 124);
+    REQUIRE(s.failures == 3);
+
+    REQUIRE(arena_pop_scope(a));
+    REQUIRE(get_arena_stats(a).used == 24);
+    REQUIRE_FALSE(arena_pop_scope(a));         // no scope left
+    REQUIRE(arena_reset(a));
+    s = get_arena_stats(a);
+    REQUIRE(s.used == 0);
+    REQUIRE(s.peak == 124);
+    REQUIRE(s.resets == 1);
+    REQUIRE(arena_alloc(a, 256) == base);      // whole region available again
+    REQUIRE(memory.size() == (size_t)before + 1);   // no per-object blocks
+
+    int b = arena_create(64);
+    REQUIRE(get_arena_stats(0).arenas == 2);
+    REQUIRE(arena_destroy(a));
+    REQUIRE_FALSE(arena_destroy(a));
+    REQUIRE(arena_alloc(a, 1) == SIZE_MAX);
+    REQUIRE(arena_destroy(b));
+    REQUIRE(memory.size() == 1);
+    REQUIRE(arena_create(2 * MEMORY_SIZE) == -1);
+}
+
+TEST_CASE("Stack strategy bumps, rejects out-of-order frees and pops to markers", "[stack]") {
+    initialize_memory();
+    set_strategy(Stack);
+    REQUIRE(push_marker() == 0);
+
+    int a = allocate(100);
+    size_t mark = push_marker();
+    REQUIRE(mark == 100);
+    int b = allocate(50);
+    int c = allocate(30);
+    REQUIRE(memory[2].start == 150);
+
+    REQUIRE_FALSE(free_block(b));          // not the top
+    REQUIRE_FALSE(free_at(100));
+    REQUIRE(free_block(c));
+    REQUIRE(free_block(b));
+    REQUIRE(push_marker() == mark);
+
+    allocate(10);
+    allocate(20);
+    REQUIRE(pop_to_marker(mark));
+    REQUIRE(memory.size() == 2);
+    REQUIRE(memory[1].start == 100);
+    REQUIRE_FALSE(memory[1].used);
+    REQUIRE_FALSE(pop_to_marker(500));     // above the current top
+    REQUIRE(pop_to_marker(0));
+    REQUIRE(memory.size() == 1);
+    REQUIRE_FALSE(free_block(a));
+
+    // a LIFO workload runs without a single rejected free
+    WorkloadConfig config;
+    config.pattern = StackLifo;
+    config.ops = 2000;
+    WorkloadGenerator workload(config);
+    vector<int> ids;
+    for (int i = 0; i < config.ops; i++) {
+        WorkloadOp op = workload.next();
+        if (op.alloc) {
+            ids.push_back(allocate(op.size));
+        } else if (ids[op.target] != -1) {
+            REQUIRE(free_block(ids[op.target]));
+            ids[op.target] = -1;
+        }
+    }
+
+    set_strategy(FirstFit);
+    REQUIRE(push_marker() == SIZE_MAX);
+}
+
+namespace {
+struct Counted {
+    int constructed = 0;
+    int destroyed = 0;
+};
+
+void counted_ctor(void* obj, void* arg) {
+    memset(obj, 0x5A, 32);
+    static_cast<Counted*>(arg)->constructed++;
+}
+
+void counted_dtor(void*, void* arg) {
+    static_cast<Counted*>(arg)->destroyed++;
+}
+}
+
+TEST_CASE("Object caches reuse constructed objects and reclaim under pressure", "[object-cache]") {
+    initialize_memory();
+    set_strategy(FirstFit);
+    Counted counts;
+    REQUIRE(cache_create(32, counted_ctor, counted_dtor, &counts) == -1);   // needs backing
+
+    REQUIRE(set_real_backing(true));
+    int cache = cache_create(32, counted_ctor, counted_dtor, &counts, 2);
+    REQUIRE(cache > 0);
+
+    size_t a = cache_alloc(cache);
+    size_t b = cache_alloc(cache);
+    size_t c = cache_alloc(cache);
+    REQUIRE(counts.constructed == 3);
+    REQUIRE((unsigned char)heap_base()[a] == 0x5A);
+
+    REQUIRE(cache_free(cache, a));
+    REQUIRE_FALSE(cache_free(cache, a));     // not live any more
+    REQUIRE(cache_free(cache, b));
+    REQUIRE(cache_free(cache, c));           // over depth 2: destroyed and freed
+    REQUIRE(counts.destroyed == 1);
+    CacheStats s = get_cache_stats(cache);
+    REQUIRE(s.cached == 2);
+    REQUIRE(s.live == 0);
+
+    // reuse skips the heap and the constructor
+    size_t used_before = get_heap_stats().used_blocks;
+    size_t again = cache_alloc(cache);
+    REQUIRE((again == a || again == b));
+    REQUIRE(counts.constructed == 3);
+    REQUIRE(get_heap_stats().used_blocks == used_before);
+    REQUIRE(get_cache_stats(cache).hits == 1);
+    REQUIRE(cache_free(cache, again));
+
+    // a request that only fits once the cache lets go of its objects
+    size_t free_now = get_heap_stats().total_free;
+    int big = allocate(free_now + 32);
+    REQUIRE(big != -1);
+    s = get_cache_stats(cache);
+    REQUIRE(s.cached == 0);
+    REQUIRE(s.reclaimed == 2);
+    REQUIRE(counts.destroyed == 3);
+    REQUIRE(free_block(big));
+    REQUIRE(memory.size() == 1);
+
+    REQUIRE(set_real_backing(false));
+    REQUIRE(cache_alloc(cache) == SIZE_MAX);
+    initialize_memory();
+}
+
+TEST_CASE("Size classes derived from a request profile", "[size-profile]") {
+    initialize_memory();
+    set_strategy(FirstFit);
+    clear_size_profile();
+    set_size_profiling(true);
+    for (int i = 0; i < 30; i++) {
+        for (size_t size : {44, 48, 70, 72, 136}) {
+            int id = allocate(size);
+            REQUIRE(id != -1);
+            REQUIRE(free_block(id));
+        }
+    }
+    set_size_profiling(false);
+    allocate(8);   // not recorded
+    REQUIRE(profiled_requests() == 150);
+
+    vector<size_t> three = derive_size_classes(3, 256);
+    REQUIRE(three == vector<size_t>{48, 72, 136});
+    REQUIRE(size_class_waste(three) == 30 * (4 + 2));
+    vector<size_t> five = derive_size_classes(5, 256);
+    REQUIRE(five.size() == 5);
+    REQUIRE(size_class_waste(five) == 0);
+    REQUIRE(derive_size_classes(10, 100) == vector<size_t>{44, 48, 70, 72});
+    REQUIRE(derive_size_classes(1, 256) == vector<size_t>{136});
+
+    // power-of-two classes lose far more on this profile
+    REQUIRE(size_class_waste({64, 128, 256}) > 10 * size_class_waste(three));
+
+    set_startup_size_classes(three);
+    initialize_memory();
+    REQUIRE(get_size_classes() == three);
+    set_strategy(Hybrid);
+    REQUIRE(allocate(136) != -1);
+    REQUIRE(get_hybrid_stats().live_objects == 1);
+
+    set_startup_size_classes({});
+    clear_size_profile();
+    initialize_memory();
+    REQUIRE(set_small_threshold(64));
+    set_strategy(FirstFit);
+}
+
+TEST_CASE("Lifetime hints keep long-lived blocks out of short-lived churn", "[lifetime]") {
+    initialize_memory();
+    set_strategy(FirstFit);
+
+    // long-lived requests are carved from the top, short-lived from the bottom
+    int s1 = allocate(100, ShortLived);
+    int l1 = allocate(100, LongLived);
+    REQUIRE(s1 != -1);
+    REQUIRE(l1 != -1);
+    REQUIRE(memory.front().id == s1);
+    REQUIRE(memory.back().id == l1);
+    REQUIRE(memory.back().start + memory.back().size == heap_size);
+    int l2 = allocate(50, LongLived);
+    REQUIRE(memory[memory.size() - 2].id == l2);
+
+    // once the short-lived block dies the free space is one run again
+    REQUIRE(free_block(s1));
+    REQUIRE(get_heap_stats().fragments == 1);
+    REQUIRE(free_block(l1));
+    REQUIRE(free_block(l2));
+    REQUIRE(memory.size() == 1);
+
+    // the hint is ignored by strategies with their own placement
+    set_strategy(Buddy);
+    int b = allocate(100, LongLived);
+    REQUIRE(b != -1);
+    REQUIRE(memory.front().id == b);
+    REQUIRE(free_block(b));
+
+    // on a mixed-lifetime workload hinted first-fit fragments less on average
+    WorkloadConfig config;
+    config.pattern = MixedLifetime;
+    config.ops = 3000;
+    config.seed = 11;
+    double avg[2];
+    for (int hinted = 0; hinted < 2; ++hinted) {
+        initialize_memory();
+        set_strategy(FirstFit);
+        WorkloadGenerator workload(config);
+        std::vector<int> ids;
+        double sum = 0;
+        for (int i = 0; i < config.ops; ++i) {
+            WorkloadOp op = workload.next();
+            if (op.alloc) {
+                ids.push_back(hinted ? allocate(op.size, op.long_lived ? LongLived : ShortLived)
+                                     : allocate(op.size));
+            } else if (ids[op.target] != -1) {
+                REQUIRE(free_block(ids[op.target]));
+            }
+            sum += get_heap_stats().fragmentation;
+        }
+        avg[hinted] = sum / config.ops;
+    }
+    REQUIRE(avg[1] < avg[0]);
+    initialize_memory();
+}
+
+TEST_CASE("allocate_near places blocks next to their neighbour", "[locality]") {
+    initialize_memory();
+    set_strategy(FirstFit);
+    int a = allocate(100);
+    REQUIRE(allocate(100) != -1);
+    int c = allocate(100);
+    int d = allocate(100);
+    REQUIRE(free_block(a));
+    REQUIRE(free_block(c));
+
+    // first-fit would take the hole at 0; the hint takes the top of c's hole
+    int x = allocate_near(50, d);
+    REQUIRE(x != -1);
+    int xi = -1, di = -1;
+    for (size_t i = 0; i < memory.size(); ++i) {
+        if (memory[i].id == x) xi = i;
+        if (memory[i].id == d) di = i;
+    }
+    REQUIRE(xi + 1 == di);
+    REQUIRE(memory[xi].start + memory[xi].size == memory[di].start);
+
+    // above the neighbour: the free tail right after d
+    int y = allocate_near(20, d);
+    REQUIRE(memory[di + 1].id == y);
+
+    LocalityStats s = get_locality_stats();
+    REQUIRE(s.hinted == 2);
+    REQUIRE(s.placed_near == 2);
+    REQUIRE(s.avg_gap == 0.0);
+    REQUIRE(s.avg_plain_gap > 0.0);
+
+    // unknown neighbours and non-fit strategies fall back to allocate()
+    REQUIRE(allocate_near(10, 9999) != -1);
+    set_strategy(Buddy);
+    initialize_memory();
+    int p = allocate(64);
+    REQUIRE(allocate_near(64, p) != -1);
+    s = get_locality_stats();
+    REQUIRE(s.hinted == 1);
+    REQUIRE(s.fallbacks == 1);
+    initialize_memory();
+    set_strategy(FirstFit);
+}
+
+TEST_CASE("Cache model counts set-associative LRU hits and misses", "[cache-sim]") {
+    // 2 sets x 2 ways of 16-byte lines
+    CacheLevel level(64, 2, 16);
+    REQUIRE_FALSE(level.access(0));
+    REQUIRE_FALSE(level.access(2));   // same set as line 0
+    REQUIRE(level.access(0));
+    REQUIRE_FALSE(level.access(4));   // evicts line 2, the least recently used
+    REQUIRE(level.access(0));
+    REQUIRE_FALSE(level.access(2));
+    REQUIRE_FALSE(level.access(1));   // the other set is untouched
+    REQUIRE(level.hits == 2);
+    REQUIRE(level.misses == 5);
+
+    // an access spanning lines touches each; L2 catches what L1 evicts
+    CacheSimConfig config;
+    CacheSim sim(config);
+    sim.access(8, 16);                 // lines 0 and 1
+    CacheSimStats s = sim.stats();
+    REQUIRE(s.accesses == 2);
+    REQUIRE(s.memory_reads == 2);
+    for (size_t addr = 0; addr < config.l2_size; addr += config.line)
+        sim.access(addr, 1);
+    sim.access(0, 1);                  // long gone from L1, still in L2
+    s = sim.stats();
+    REQUIRE(s.l2_hit_rate > 0.0);
+    REQUIRE(s.memory_reads == config.l2_size / config.line);
+
+    // configuration is validated before the benchmark sees it
+    CacheSimConfig bad;
+    bad.line = 24;
+    REQUIRE_FALSE(set_cache_simulation(bad));
+    REQUIRE(cache_simulation() == nullptr);
+    REQUIRE(set_cache_simulation(config));
+    REQUIRE(cache_simulation() != nullptr);
+    disable_cache_simulation();
+    REQUIRE(cache_simulation() == nullptr);
+}
+
+TEST_CASE("Perf counters measure a phase or report themselves unavailable", "[perf]") {
+    PerfCounters counters;
+    counters.start();
+    volatile uint64_t sink = 0;
+    for (int i = 0; i < 100000; ++i) sink = sink + i;
+    PerfSample s = counters.stop();
+
+    // no PMU in many VMs and containers: then nothing is claimed
+    REQUIRE(s.valid == counters.available());
+    if (s.valid) {
+        REQUIRE(s.instructions > 100000);
+        REQUIRE(s.cycles > 0);
+    } else {
+        REQUIRE(s.cycles == 0);
+        REQUIRE(s.instructions == 0);
+    }
+}
+
+TEST_CASE("Tracing writes Chrome trace events off the hot path", "[trace]") {
+    initialize_memory();
+    set_strategy(FirstFit);
+    char path[] = "/tmp/alloc_trace_XXXXXX";
+    int fd = mkstemp(path);
+    REQUIRE(fd != -1);
+    close(fd);
+
+    REQUIRE(trace_start(path));
+    REQUIRE_FALSE(trace_start(path));   // one trace at a time
+    int a = allocate(100);
+    int b = allocate(100);
+    REQUIRE(free_block(a));
+    REQUIRE(free_block(b));              // merges with both neighbours
+    REQUIRE_FALSE(free_block(b));
+    TraceStats s = get_trace_stats();
+    size_t written = trace_stop();
+    REQUIRE(trace_stop() == 0);
+
+    // 1 counter at start; 2 x (allocate, split, counter); free a + counter;
+    // free b, two merges + counter; the rejected free changes no counter
+    REQUIRE(s.recorded == 1 + 6 + 2 + 4 + 1);
+    REQUIRE(s.dropped == 0);
+    REQUIRE(written == s.recorded);
+
+    FILE* f = fopen(path, "r");
+    REQUIRE(f != nullptr);
+    std::string json;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) json.append(buf, n);
+    fclose(f);
+    unlink(path);
+
+    REQUIRE(json.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0) == 0);
+    REQUIRE(json.size() >= 4);
+    REQUIRE(json.compare(json.size() - 4, 4, "\n]}\n") == 0);
+    REQUIRE(json.find("\"name\":\"allocate\",\"cat\":\"heap\",\"ph\":\"X\"") != std::string::npos);
+    REQUIRE(json.find("\"args\":{\"id\":" + std::to_string(b) + ",\"ok\":0}") != std::string::npos);
+    REQUIRE(json.find("\"name\":\"split\"") != std::string::npos);
+    REQUIRE(json.find("\"name\":\"merge\"") != std::string::npos);
+    // back to an empty heap at the end
+    REQUIRE(json.find("\"ph\":\"C\"") != std::string::npos);
+    REQUIRE(json.find("\"args\":{\"used\":0,\"free\":" + std::to_string(heap_size) + "}}")
+            != std::string::npos);
+
+    // huge spans count toward occupancy, including ones live at trace_start
+    REQUIRE(set_huge_region(256, 640));
+    int early = allocate(300);               // 5 pages = 320 bytes
+    REQUIRE(early != -1);
+    REQUIRE(trace_start(path));
+    int big = allocate(256);                 // 4 pages = 256 bytes
+    REQUIRE(big != -1);
+    REQUIRE(free_block(big));
+    REQUIRE(free_block(early));
+    trace_stop();
+    f = fopen(path, "r");
+    REQUIRE(f != nullptr);
+    json.clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) json.append(buf, n);
+    fclose(f);
+    unlink(path);
+    REQUIRE(json.find("\"args\":{\"used\":320,") != std::string::npos);
+    REQUIRE(json.find("\"args\":{\"used\":576,") != std::string::npos);
+    REQUIRE(json.find("\"args\":{\"used\":0,") != std::string::npos);
+    REQUIRE(set_huge_region(0, 0));
+
+    // exiting mid-trace still joins the writer and closes the JSON
+    pid_t pid = fork();
+    REQUIRE(pid != -1);
+    if (pid == 0) {
+        if (!trace_start(path)) _exit(2);
+        allocate(10);
+        exit(0);
+    }
+    int status = 0;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+    f = fopen(path, "r");
+    REQUIRE(f != nullptr);
+    json.clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) json.append(buf, n);
+    fclose(f);
+    unlink(path);
+    REQUIRE(json.compare(json.size() - 4, 4, "\n]}\n") == 0);
+    initialize_memory();
+}
+
+TEST_CASE("Buddy and the huge region exclude each other", "[huge][buddy]") {
+    initialize_memory();
+    set_strategy(Buddy);
+    REQUIRE_FALSE(set_huge_region(512, 256));
+    REQUIRE(get_huge_stats().region_bytes == 0);
+    REQUIRE(set_strategy(FirstFit));
+    REQUIRE(set_huge_region(512, 256));
+    REQUIRE_FALSE(set_strategy(Buddy));
+    REQUIRE(current_strategy == FirstFit);
+    REQUIRE(set_huge_region(0, 0));
+    REQUIRE(set_strategy(Buddy));
+    int id = allocate(128);
+    REQUIRE(id != -1);
+    REQUIRE(memory[0].size == 128);   // not cut short by a non-power-of-two heap
+    REQUIRE(free_block(id));
+    set_strategy(FirstFit);
+}
+
+TEST_CASE("Growth keeps the huge region and Buddy blocks consistent", "[growth]") {
+    auto tiles = []() {
+        size_t end = 0;
+        for (const auto& b : memory) {
+            if (b.start != end) return false;
+            end = b.start + b.size;
+        }
+        return true;
+    };
+
+    // a grown heap shrinks back on reset; the region is re-carved below the top
+    initialize_memory();
+    set_heap_growth(512);
+    int big = allocate(1200);
+    REQUIRE(big != -1);
+    REQUIRE(heap_size > MEMORY_SIZE);
+    REQUIRE(free_block(big));
+    initialize_memory();
+    REQUIRE(heap_size == MEMORY_SIZE);
+    REQUIRE(set_huge_region(256, 256));
+    initialize_memory();
+    REQUIRE(get_huge_stats().region_start == MEMORY_SIZE - 256);
+    REQUIRE(memory.back().start + memory.back().size == MEMORY_SIZE - 256);
+
+    // no growth above the region; removing it merges it back in place
+    REQUIRE(allocate(900) == -1);
+    REQUIRE(heap_size == MEMORY_SIZE);
+    REQUIRE(set_huge_region(0, 0));
+    REQUIRE(memory.size() == 1);
+    REQUIRE(memory[0].size == MEMORY_SIZE);
+
+    // Buddy never grows, so every block stays a power of two and the heap tiles
+    set_strategy(Buddy);
+    initialize_memory();
+    std::vector<int> ids;
+    for (int i = 0; i < 20; ++i) ids.push_back(allocate(100 + i * 7));
+    REQUIRE(heap_size == MEMORY_SIZE);
+    for (const auto& b : memory) REQUIRE((b.size & (b.size - 1)) == 0);
+    REQUIRE(tiles());
+    for (int id : ids)
+        if (id != -1) REQUIRE(free_block(id));
+    REQUIRE(memory.size() == 1);
+
+    set_heap_growth(0);
+    set_strategy(FirstFit);
+    initialize_memory();
+}